@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include <CommonDef.h>
+
+#include "Analyzer/Keywords.h"
+#include "Analyzer/Lexer.h"
+#include "IO/SourceFile.h"
+
+using namespace cmm;
+using namespace cmm::cmc;
+
+namespace {
+    // How the lexer told keywords apart from identifiers before KeywordOrIdentifier(), kept as it was.
+    TokenType ChainedKeywordOrIdentifier(const std::string_view ident) noexcept
+    {
+        if (ident == "let")
+            return TokenType::KeywordLet;
+        else if (ident == "fn")
+            return TokenType::KeywordFn;
+        else if (ident == "import")
+            return TokenType::KeywordImport;
+        else if (ident == "if")
+            return TokenType::KeywordIf;
+        else if (ident == "else")
+            return TokenType::KeywordElse;
+        else if (ident == "while")
+            return TokenType::KeywordWhile;
+        else if (ident == "i32")
+            return TokenType::KeywordI32;
+        else if (ident == "i64")
+            return TokenType::KeywordI64;
+        else if (ident == "string")
+            return TokenType::KeywordString;
+        else if (ident == "bool")
+            return TokenType::KeywordBool;
+        else if (ident == "char")
+            return TokenType::KeywordChar;
+        else if (ident == "return")
+            return TokenType::KeywordReturn;
+        else if (ident == "false")
+            return TokenType::KeywordFalse;
+        else if (ident == "true")
+            return TokenType::KeywordTrue;
+        else
+            return TokenType::Identifier;
+    }
+
+    // The best time of a few runs of classifying every word, in ns per word. The token types are summed up into
+    // checksum, which gets printed so none of the work can be left out.
+    template <typename F>
+    double TimeClassifier(const std::vector<std::string_view>& words, const int runs, F&& classify, u64& checksum)
+    {
+        double best = 1e300;
+        u64    sum{};
+        for (int run = 0; run < runs; ++run)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            for (const auto word : words)
+                sum += (u64)classify(word);
+            const auto end = std::chrono::steady_clock::now();
+            best           = std::min(best, std::chrono::duration<double, std::nano>(end - start).count());
+        }
+        checksum = sum;
+        return best / (double)std::max<usize>(words.size(), 1);
+    }
+} // namespace
+
+// Serial lexing throughput, the best of a few runs. Identifiers aren't interned so only the lexer itself is measured,
+// which on keyword and identifier heavy code is mostly telling keywords apart from identifiers. That part is then
+// timed on its own, over every identifier and keyword of the source, both with the perfect hash the lexer uses and
+// with the chain of comparisons it replaced. generate.py identifiers writes input made for it.
+int main(int argc, const char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage:\n\tcmc-bench-lexer [file] [runs]" << std::endl;
+        return 1;
+    }
+
+    const auto source = SourceFile::Open(argv[1]);
+    if (!source)
+    {
+        std::cerr << "cmc-bench-lexer: input file non-existent." << std::endl;
+        return 1;
+    }
+    const auto src  = source->GetView();
+    const int  runs = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 9;
+
+    double best = 1e300;
+    usize  tokens{};
+    usize  keywords{};
+    for (int run = 0; run < runs; ++run)
+    {
+        Lexer lexer{ src };
+        lexer.SetStringTable(nullptr);
+
+        const auto start  = std::chrono::steady_clock::now();
+        const auto stream = lexer.TokenizeAll();
+        const auto end    = std::chrono::steady_clock::now();
+        best              = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+
+        tokens   = stream.Size();
+        keywords = 0;
+        for (usize i = 0; i < stream.Size(); ++i)
+            keywords += Token{ .type = stream.GetType(i) }.IsKeyword();
+    }
+
+    fmt::print("{} bytes, {} tokens, {} keywords\n", src.size(), tokens, keywords);
+    fmt::print("lex: {:.1f} ms, {:.1f} MB/s, {:.2f} ns/token (best of {})\n", best, src.size() / best / 1000.0,
+               best * 1e6 / (double)tokens, runs);
+
+    Lexer lexer{ src };
+    lexer.SetStringTable(nullptr);
+    const auto                    stream = lexer.TokenizeAll();
+    std::vector<std::string_view> words{};
+    for (usize i = 0; i < stream.Size(); ++i)
+    {
+        const auto token = stream.Get(i);
+        if (token.type == TokenType::Identifier || token.IsKeyword())
+            words.push_back(token.span.text);
+    }
+    for (const auto word : words)
+    {
+        if (KeywordOrIdentifier(word) != ChainedKeywordOrIdentifier(word))
+        {
+            std::cerr << "cmc-bench-lexer: the perfect hash and the chain disagree on '" << word << "'." << std::endl;
+            return 1;
+        }
+    }
+
+    // Plenty of runs, a single one over a few MiB of words is over in a millisecond or two.
+    const int  classify_runs = runs * 10;
+    u64        hash_sum{};
+    u64        chain_sum{};
+    const auto hash  = TimeClassifier(words, classify_runs, KeywordOrIdentifier, hash_sum);
+    const auto chain = TimeClassifier(words, classify_runs, ChainedKeywordOrIdentifier, chain_sum);
+    fmt::print("keywords: {} words, perfect hash {:.2f} ns/word, chain of comparisons {:.2f} ns/word, {:.2f}x "
+               "(best of {}, checksums {} {})\n",
+               words.size(), hash, chain, chain / hash, classify_runs, hash_sum, chain_sum);
+    return 0;
+}
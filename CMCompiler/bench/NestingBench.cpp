@@ -0,0 +1,55 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include <fmt/core.h>
+
+#include <CommonDef.h>
+
+#include "Analyzer/Parser.h"
+#include "Compiler/Compiler.h"
+#include "IO/ResourceUsage.h"
+
+using namespace cmm;
+using namespace cmm::cmc;
+
+// Parses and compiles a single function of depth nested statements, either plain blocks or if and while statements
+// taking turns. Nesting has to be bounded by memory and not by the native stack, so this must not crash however deep
+// it goes.
+int main(int argc, const char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage:\n\tcmc-bench-nesting [depth] [blocks|if-while]" << std::endl;
+        return 1;
+    }
+
+    const usize depth      = std::strtoull(argv[1], nullptr, 10);
+    const bool  conditions = argc > 2 && std::string_view{ argv[2] } == "if-while";
+
+    std::string src = "fn main() -> i32 {\n";
+    for (usize i = 0; i < depth; ++i)
+    {
+        if (conditions)
+            src += (i & 1) ? "while true " : "if true ";
+        src += "{ ";
+    }
+    src += "let a: i64 = 1; ";
+    for (usize i = 0; i < depth; ++i)
+        src += "} ";
+    src += "\n}\n";
+
+    const auto start    = std::chrono::steady_clock::now();
+    auto       tree     = Parser(src).Parse();
+    const auto parsed   = std::chrono::steady_clock::now();
+    const auto program  = Compiler(std::move(tree)).Compile();
+    const auto compiled = std::chrono::steady_clock::now();
+
+    fmt::print("depth {} ({}): parse {:.1f} ms, compile {:.1f} ms, {} instructions, peak RSS {} KiB\n", depth,
+               conditions ? "if-while" : "blocks", std::chrono::duration<double, std::milli>(parsed - start).count(),
+               std::chrono::duration<double, std::milli>(compiled - parsed).count(), program.code.size(),
+               GetPeakResidentSize());
+    return 0;
+}
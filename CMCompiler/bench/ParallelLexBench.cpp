@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include <CommonDef.h>
+
+#include "Analyzer/Lexer.h"
+#include "IO/SourceFile.h"
+
+using namespace cmm;
+using namespace cmm::cmc;
+
+namespace {
+    bool IsSameStream(const TokenStream& lhs, const TokenStream& rhs) noexcept
+    {
+        if (lhs.Size() != rhs.Size())
+            return false;
+        for (usize i = 0; i < lhs.Size(); ++i)
+        {
+            const auto a = lhs.Get(i);
+            const auto b = rhs.Get(i);
+            if (a.type != b.type || a.num != b.num || a.span.offset != b.span.offset ||
+                a.span.text.size() != b.span.text.size())
+                return false;
+        }
+        return true;
+    }
+} // namespace
+
+// TokenizeParallel() against the serial TokenizeAll() for a range of worker counts, the best of a few runs each. Every
+// stream is checked to be the serial one first. Only the splitting and stitching show up on a single core, sources
+// under MinParallelChunkSize per worker are lexed serially.
+int main(int argc, const char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage:\n\tcmc-bench-parallel-lexer [file] [workers...]" << std::endl;
+        return 1;
+    }
+
+    const auto source = SourceFile::Open(argv[1]);
+    if (!source)
+    {
+        std::cerr << "cmc-bench-parallel-lexer: input file non-existent." << std::endl;
+        return 1;
+    }
+    const auto src = source->GetView();
+
+    std::vector<usize> worker_counts{};
+    for (int i = 2; i < argc; ++i)
+        worker_counts.push_back((usize)std::max(std::atoi(argv[i]), 1));
+    if (worker_counts.empty())
+        worker_counts = { 1, 2, 4, 8, 16 };
+
+    constexpr int Runs   = 5;
+    const auto    serial = Lexer(src).TokenizeAll();
+    fmt::print("{} bytes, {} tokens\n", src.size(), serial.Size());
+    for (const auto workers : worker_counts)
+    {
+        double best = 1e300;
+        for (int run = 0; run < Runs; ++run)
+        {
+            const auto start  = std::chrono::steady_clock::now();
+            const auto stream = Lexer(src).TokenizeParallel(workers);
+            const auto end    = std::chrono::steady_clock::now();
+            best              = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+            if (run == 0 && !IsSameStream(serial, stream))
+            {
+                std::cerr << "cmc-bench-parallel-lexer: " << workers << " workers lex a different stream." << std::endl;
+                return 1;
+            }
+        }
+        fmt::print("workers {:>2}: {:.1f} ms, {:.1f} MB/s (best of {})\n", workers, best, src.size() / best / 1000.0,
+                   Runs);
+    }
+    return 0;
+}
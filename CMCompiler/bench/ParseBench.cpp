@@ -0,0 +1,52 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include <fmt/core.h>
+
+#include <CommonDef.h>
+
+#include "Analyzer/Parser.h"
+#include "IO/SourceFile.h"
+
+using namespace cmm;
+using namespace cmm::cmc;
+
+// Parsing on its own, the best of a few runs over tokens lexed once up front. Expression heavy input spends most of
+// it in the Pratt loop.
+int main(int argc, const char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage:\n\tcmc-bench-parser [file] [runs]" << std::endl;
+        return 1;
+    }
+
+    const auto source = SourceFile::Open(argv[1]);
+    if (!source)
+    {
+        std::cerr << "cmc-bench-parser: input file non-existent." << std::endl;
+        return 1;
+    }
+    const auto src    = source->GetView();
+    const int  runs   = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 15;
+    const auto tokens = Lexer(src).TokenizeAll();
+
+    double best = 1e300;
+    usize  nodes{};
+    for (int run = 0; run < runs; ++run)
+    {
+        Parser     parser{ tokens };
+        const auto start = std::chrono::steady_clock::now();
+        const auto tree  = std::move(parser).Parse();
+        const auto end   = std::chrono::steady_clock::now();
+        best             = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+        nodes            = tree.Size();
+    }
+
+    fmt::print("{} bytes, {} tokens, {} nodes\n", src.size(), tokens.Size(), nodes);
+    fmt::print("parse: {:.1f} ms, {:.2f} M nodes/s, {:.2f} M tokens/s (best of {})\n", best, nodes / best / 1000.0,
+               tokens.Size() / best / 1000.0, runs);
+    return 0;
+}
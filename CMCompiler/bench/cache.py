@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+# Wall time and peak RSS of cmc on a source without the AST cache, with a cold cache and with a warm one.
+#
+#   cache.py <cmc> <file> [runs]
+#
+# A cold run starts from an empty cache directory and writes the snapshot, a warm run loads it. The best and the
+# median of every mode are reported, peak RSS is the largest of any of its runs.
+
+import os
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+def run(args):
+    start = time.perf_counter()
+    process = subprocess.Popen(args, stdout=subprocess.DEVNULL)
+    _, status, usage = os.wait4(process.pid, 0)
+    elapsed = (time.perf_counter() - start) * 1000
+    if os.WIFSIGNALED(status):
+        print(f'{" ".join(args)} died with signal {os.WTERMSIG(status)}', file=sys.stderr)
+        sys.exit(1)
+    # ru_maxrss is in bytes on macOS and in kibibytes everywhere else.
+    rss = usage.ru_maxrss / (1024 * 1024 if sys.platform == 'darwin' else 1024)
+    return elapsed, rss
+
+def report(mode, results):
+    times = [t for t, _ in results]
+    print(f'{mode:>8}: best {min(times):7.1f} ms, median {statistics.median(times):7.1f} ms, '
+          f'peak RSS {max(rss for _, rss in results):6.1f} MiB')
+
+if len(sys.argv) < 3:
+    print('Usage: cache.py <cmc> <file> [runs]', file=sys.stderr)
+    sys.exit(1)
+
+cmc, source = sys.argv[1], sys.argv[2]
+runs = int(sys.argv[3]) if len(sys.argv) > 3 else 5
+cache = tempfile.mkdtemp(prefix='cmc-cache-')
+try:
+    uncached = [run([cmc, source]) for _ in range(runs)]
+
+    cold = []
+    for _ in range(runs):
+        shutil.rmtree(cache)
+        os.mkdir(cache)
+        cold.append(run([cmc, f'--cache-dir={cache}', source]))
+
+    warm = [run([cmc, f'--cache-dir={cache}', source]) for _ in range(runs)]
+
+    print(f'{source}: {os.path.getsize(source) / (1024 * 1024):.1f} MiB, {runs} runs each')
+    report('no cache', uncached)
+    report('cold', cold)
+    report('warm', warm)
+finally:
+    shutil.rmtree(cache, ignore_errors=True)
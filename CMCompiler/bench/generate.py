@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+# Writes a program for the benchmarks to stdout, deterministic for a given seed.
+#
+#   generate.py program <functions> [seed]
+#       Functions with a bit of everything the language has, keyword and identifier heavy. 20000 functions make
+#       6.5 MiB, 60000 make 20 MiB.
+#
+#   generate.py literals <functions> [seed]
+#       Multi-line and empty strings and character literals of quotes and newlines, every place a newline doesn't end a
+#       token. For the lexer only, the parser rejects empty strings. 60000 functions make about 10 MiB.
+#
+#   generate.py identifiers <lines> [seed]
+#       Nothing but words, for the lexer only. One in ten is a keyword, two in ten are a keyword with a character
+#       added, dropped or changed and the rest are random identifiers. 100000 lines make about 8 MiB.
+#
+#   generate.py expressions <functions> [seed]
+#       20 declarations a function, each a chain of 30 terms joined by + - * /, every fifth one two chains compared with
+#       <. 2000 functions make about 7 MiB.
+
+import random
+import sys
+
+def program(count):
+    out = []
+    for i in range(count):
+        out.append(f'fn f{i}(a: i64, b: i64, s: string) -> i64 {{')
+        out.append(f'    let x: i64 = a * {random.randint(1, 99)} + b - {random.randint(0, 9)} * a;')
+        out.append(f'    let y: i64 = 60 * 60 * 24;')
+        out.append(f"    let c: char = 'q';")
+        out.append(f'    let msg: string = "hello world {i}";')
+        out.append(f'    let arr: i64[3] = {{ 1, 2, 3 }};')
+        out.append(f'    while x > y {{ x = x - 1; }}')
+        out.append(f'    if x == y {{ let z: bool = true; }}')
+        if i > 0:
+            out.append(f'    let r: i64 = f{i - 1}(x, y, msg);')
+        out.append(f'    return x / {random.randint(1, 9)};')
+        out.append('}')
+        out.append('')
+    return out
+
+def literals(count):
+    out = []
+    for i in range(count):
+        lines = '\n'.join(f'line {j} of {i}' for j in range(random.randint(1, 4)))
+        out.append(f'fn f{i}() -> i64 {{')
+        out.append(f'    let s: string = "{lines}";')
+        out.append(f'    let e: string = "";')
+        out.append(f"    let q: char = '\"';")
+        out.append(f"    let n: char = '\n';")
+        out.append(f'    return {random.randint(0, 99)};')
+        out.append('}')
+        out.append('')
+    return out
+
+KEYWORDS = ['let', 'fn', 'import', 'if', 'else', 'while', 'i32', 'i64', 'string', 'bool', 'char', 'return', 'true',
+            'false']
+FIRST = 'abcdefghijklmnopqrstuvwxyz_'
+REST = FIRST + '0123456789'
+
+# Still an identifier, a digit never takes the place of the first character.
+def near_miss(keyword):
+    i = random.randrange(len(keyword) + 1)
+    edit = random.choice('add drop change'.split()) if len(keyword) > 2 else 'add'
+    if edit == 'add':
+        return keyword[:i] + random.choice(REST if i > 0 else FIRST) + keyword[i:]
+    i = random.randrange(1, len(keyword))
+    if edit == 'drop':
+        return keyword[:i] + keyword[i + 1:]
+    return keyword[:i] + random.choice(REST.replace(keyword[i], '')) + keyword[i + 1:]
+
+def identifiers(count):
+    def word():
+        roll = random.random()
+        if roll < 0.1:
+            return random.choice(KEYWORDS)
+        if roll < 0.3:
+            return near_miss(random.choice(KEYWORDS))
+        return random.choice(FIRST) + ''.join(random.choice(REST) for _ in range(random.randint(0, 11)))
+
+    return [' '.join(word() for _ in range(12)) for _ in range(count)]
+
+def expressions(count):
+    def chain(names, terms):
+        text = random.choice(names) if names else str(random.randint(1, 999))
+        for _ in range(terms - 1):
+            op = random.choice('+-*/')
+            literal = op == '/' or not names or random.random() < 0.5
+            operand = str(random.randint(1, 999)) if literal else random.choice(names)
+            text += f' {op} {operand}'
+        return text
+
+    out = []
+    for i in range(count):
+        names = []
+        out.append(f'fn f{i}(a: i64, b: i64) -> i64 {{')
+        for j in range(20):
+            if j % 5 == 4:
+                out.append(f'    let c{j}: bool = {chain(names + ["a", "b"], 15)} < {chain(names + ["a", "b"], 15)};')
+            else:
+                out.append(f'    let v{j}: i64 = {chain(names + ["a", "b"], 30)};')
+                names.append(f'v{j}')
+        out.append('    return a;')
+        out.append('}')
+        out.append('')
+    return out
+
+generators = { 'program': program, 'literals': literals, 'identifiers': identifiers, 'expressions': expressions }
+
+if len(sys.argv) < 3 or sys.argv[1] not in generators:
+    print(f'Usage: generate.py <{"|".join(generators)}> <count> [seed]', file=sys.stderr)
+    sys.exit(1)
+
+random.seed(int(sys.argv[3]) if len(sys.argv) > 3 else 1)
+sys.stdout.write('\n'.join(generators[sys.argv[1]](int(sys.argv[2]))))
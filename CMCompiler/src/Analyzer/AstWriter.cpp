@@ -0,0 +1,237 @@
+#include "AstWriter.h"
+
+#include <array>
+#include <charconv>
+
+namespace cmm::cmc::ast {
+    namespace {
+        // The names the nlohmann serializers give an enum's values, looked up once so the names are only spelled out
+        // in one place.
+        template <typename E, usize Count>
+        std::string_view NameOfValue(const E value)
+        {
+            static const auto names = [] {
+                std::array<std::string, Count> names{};
+                for (usize i = 0; i < Count; ++i)
+                    names[i] = nlohmann::ordered_json((E)i).template get<std::string>();
+                return names;
+            }();
+            return names[(usize)value];
+        }
+
+        constexpr usize StatementKindCount   = (usize)StatementKind::LiteralExpression + 1;
+        constexpr usize FundamentalTypeCount = (usize)FundamentalType::UserDefined + 1;
+        constexpr usize TokenTypeCount       = (usize)TokenType::Eof + 1;
+    } // namespace
+
+    AstWriter::AstWriter(std::ostream& out, const Style style) noexcept : m_Out(out), m_Style(style)
+    {
+    }
+
+    void AstWriter::Write(const SyntaxTree& tree)
+    {
+        struct Frame
+        {
+            NodeId id{};
+            usize  next_child{};
+        };
+
+        BeginArray();
+        std::vector<Frame> open{};
+        for (const auto global : tree.GetGlobals())
+        {
+            Element();
+            WriteStatementHead(tree, global);
+            open.push_back(Frame{ .id = global });
+            while (!open.empty())
+            {
+                // A statement is done with once all of its children are, only then come its type and tokens.
+                const auto children = tree.GetChildren(open.back().id);
+                if (open.back().next_child < children.size())
+                {
+                    const auto child = children[open.back().next_child++];
+                    Element();
+                    WriteStatementHead(tree, child);
+                    open.push_back(Frame{ .id = child });
+                }
+                else
+                {
+                    WriteStatementTail(tree, open.back().id);
+                    open.pop_back();
+                }
+            }
+        }
+        End(']');
+
+        m_Out.write(m_Buffer.data(), (std::streamsize)m_Buffer.size());
+        m_Buffer.clear();
+    }
+
+    void AstWriter::WriteStatementHead(const SyntaxTree& tree, const NodeId id)
+    {
+        const auto& s = tree[id];
+        BeginObject();
+        Key("name");
+        String(NameOf(s.name));
+        Key("kind");
+        String(NameOfValue<StatementKind, StatementKindCount>(s.kind));
+        Key("children");
+        BeginArray();
+    }
+
+    void AstWriter::WriteStatementTail(const SyntaxTree& tree, const NodeId id)
+    {
+        const auto& s = tree[id];
+        End(']');
+        Key("type");
+        if (m_Style == Style::Compact)
+            String(TypeOf(s.type).ToString());
+        else
+            WriteType(TypeOf(s.type));
+        Key("tokens");
+        BeginArray();
+        for (usize i = 0; i < s.token_count; ++i)
+        {
+            Element();
+            if (m_Style == Style::Compact)
+                Number((i64)tree.GetToken(id, i).span.offset);
+            else
+                WriteToken(tree.GetToken(id, i));
+        }
+        End(']');
+        End('}');
+        FlushIfFull();
+    }
+
+    void AstWriter::WriteType(const Type& type)
+    {
+        BeginObject();
+        Key("name");
+        String(type.name);
+        Key("ftype");
+        String(NameOfValue<FundamentalType, FundamentalTypeCount>(type.ftype));
+        Key("fields");
+        BeginArray();
+        for (const auto field : type.fields)
+        {
+            Element();
+            WriteType(TypeOf(field));
+        }
+        End(']');
+        Key("length");
+        Number((i64)type.length);
+        Key("size");
+        Number(type.size);
+        End('}');
+    }
+
+    void AstWriter::WriteToken(const Token& token)
+    {
+        BeginObject();
+        Key("type");
+        String(NameOfValue<TokenType, TokenTypeCount>(token.type));
+        Key("span");
+        BeginObject();
+        Key("offset");
+        Number(token.span.offset);
+        Key("text");
+        String(token.span.text);
+        End('}');
+        Key("num");
+        Number(token.num);
+        End('}');
+    }
+
+    void AstWriter::BeginObject()
+    {
+        m_Buffer += '{';
+        m_Containers.push_back(false);
+    }
+
+    void AstWriter::BeginArray()
+    {
+        m_Buffer += '[';
+        m_Containers.push_back(false);
+    }
+
+    void AstWriter::End(const char close)
+    {
+        // Empty objects and arrays close on the same line they were opened on.
+        const bool has_elements = m_Containers.back();
+        m_Containers.pop_back();
+        if (has_elements)
+            Newline();
+        m_Buffer += close;
+    }
+
+    void AstWriter::Key(const std::string_view key)
+    {
+        Element();
+        String(key);
+        m_Buffer += (m_Style == Style::Pretty) ? ": " : ":";
+    }
+
+    void AstWriter::Element()
+    {
+        if (m_Containers.back())
+            m_Buffer += ',';
+        m_Containers.back() = true;
+        Newline();
+    }
+
+    void AstWriter::String(const std::string_view str)
+    {
+        // Escaped the same way nlohmann does it.
+        constexpr char hex[] = "0123456789abcdef";
+        m_Buffer += '"';
+        for (const char c : str)
+        {
+            switch (c)
+            {
+                case '"': m_Buffer += "\\\""; break;
+                case '\\': m_Buffer += "\\\\"; break;
+                case '\b': m_Buffer += "\\b"; break;
+                case '\f': m_Buffer += "\\f"; break;
+                case '\n': m_Buffer += "\\n"; break;
+                case '\r': m_Buffer += "\\r"; break;
+                case '\t': m_Buffer += "\\t"; break;
+                default:
+                    if ((u8)c < 0x20)
+                    {
+                        m_Buffer += "\\u00";
+                        m_Buffer += hex[(u8)c >> 4];
+                        m_Buffer += hex[(u8)c & 0xf];
+                    }
+                    else
+                        m_Buffer += c;
+                    break;
+            }
+        }
+        m_Buffer += '"';
+    }
+
+    void AstWriter::Number(const i64 value)
+    {
+        char       digits[24]{};
+        const auto result = std::to_chars(std::begin(digits), std::end(digits), value);
+        m_Buffer.append(digits, result.ptr);
+    }
+
+    void AstWriter::Newline()
+    {
+        if (m_Style == Style::Pretty)
+        {
+            m_Buffer += '\n';
+            m_Buffer.append(m_Containers.size() * IndentSize, ' ');
+        }
+    }
+
+    void AstWriter::FlushIfFull()
+    {
+        if (m_Buffer.size() >= FlushSize)
+        {
+            m_Out.write(m_Buffer.data(), (std::streamsize)m_Buffer.size());
+            m_Buffer.clear();
+        }
+    }
+} // namespace cmm::cmc::ast
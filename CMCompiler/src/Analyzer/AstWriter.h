@@ -0,0 +1,60 @@
+#ifndef CMC_ANALYZER_AST_WRITER_H
+#define CMC_ANALYZER_AST_WRITER_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Parser.h"
+
+namespace cmm::cmc::ast {
+    // Writes a tree out as JSON while walking it, no document is built in between and the output goes out in chunks.
+    // The tree is walked with a stack of our own so any nesting depth can be written.
+    class AstWriter
+    {
+    public:
+        enum class Style : u8
+        {
+            // On one line, every statement's type is its name and every token its offset in the source.
+            Compact,
+            // The layout the tree always had as an nlohmann::ordered_json, indented like it was printed with
+            // std::setw(4). Types are written out with their fields and tokens with their text.
+            Pretty
+        };
+
+    private:
+        static constexpr usize FlushSize  = 64 * 1024;
+        static constexpr usize IndentSize = 4;
+
+    private:
+        std::ostream&     m_Out;
+        Style             m_Style{};
+        std::string       m_Buffer{};
+        std::vector<bool> m_Containers{}; // Whether each open object or array has an element yet.
+
+    public:
+        AstWriter(std::ostream& out, const Style style) noexcept;
+
+    public:
+        void Write(const SyntaxTree& tree);
+
+    private:
+        void WriteStatementHead(const SyntaxTree& tree, const NodeId id);
+        void WriteStatementTail(const SyntaxTree& tree, const NodeId id);
+        void WriteType(const Type& type);
+        void WriteToken(const Token& token);
+
+    private:
+        void BeginObject();
+        void BeginArray();
+        void End(const char close);
+        void Key(const std::string_view key);
+        void Element();
+        void String(const std::string_view str);
+        void Number(const i64 value);
+        void Newline();
+        void FlushIfFull();
+    };
+} // namespace cmm::cmc::ast
+
+#endif // CMC_ANALYZER_AST_WRITER_H
@@ -0,0 +1,167 @@
+#include "CharScan.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CMC_SCAN_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CMC_SCAN_SSE2
+#endif
+
+namespace cmm::cmc {
+    namespace {
+#if defined(CMC_SCAN_AVX2)
+        using Vector               = __m256i;
+        using Mask                 = u32;
+        constexpr usize VectorSize = 32;
+
+        inline Vector Load(const char* ptr) noexcept { return _mm256_loadu_si256((const __m256i*)ptr); }
+        inline Vector Splat(const char c) noexcept { return _mm256_set1_epi8(c); }
+        inline Vector Equals(const Vector a, const Vector b) noexcept { return _mm256_cmpeq_epi8(a, b); }
+        inline Vector GreaterThan(const Vector a, const Vector b) noexcept { return _mm256_cmpgt_epi8(a, b); }
+        inline Vector Or(const Vector a, const Vector b) noexcept { return _mm256_or_si256(a, b); }
+        inline Vector Add(const Vector a, const Vector b) noexcept { return _mm256_add_epi8(a, b); }
+        inline Mask   MoveMask(const Vector v) noexcept { return (Mask)_mm256_movemask_epi8(v); }
+#elif defined(CMC_SCAN_SSE2)
+        using Vector               = __m128i;
+        using Mask                 = u32;
+        constexpr usize VectorSize = 16;
+
+        inline Vector Load(const char* ptr) noexcept { return _mm_loadu_si128((const __m128i*)ptr); }
+        inline Vector Splat(const char c) noexcept { return _mm_set1_epi8(c); }
+        inline Vector Equals(const Vector a, const Vector b) noexcept { return _mm_cmpeq_epi8(a, b); }
+        inline Vector GreaterThan(const Vector a, const Vector b) noexcept { return _mm_cmpgt_epi8(a, b); }
+        inline Vector Or(const Vector a, const Vector b) noexcept { return _mm_or_si128(a, b); }
+        inline Vector Add(const Vector a, const Vector b) noexcept { return _mm_add_epi8(a, b); }
+        inline Mask   MoveMask(const Vector v) noexcept { return (Mask)_mm_movemask_epi8(v); }
+#endif
+
+#if defined(CMC_SCAN_AVX2) || defined(CMC_SCAN_SSE2)
+        // Every lane set to one.
+        constexpr Mask FullMask = (Mask)((VectorSize == 32) ? ~0ull : (1ull << VectorSize) - 1);
+
+        // Lanes that fall within [lo, hi]. There's no unsigned byte comparison so both sides are biased by 0x80 and
+        // compared as signed instead.
+        inline Vector InRange(const Vector v, const char lo, const char hi) noexcept
+        {
+            const Vector biased = Add(v, Splat((char)(0x80 - lo)));
+            return GreaterThan(Splat((char)(hi - lo + 1 - 0x80)), biased);
+        }
+#endif
+    } // namespace
+
+    const char* SkipWhitespace(const char* begin, const char* end) noexcept
+    {
+        // Most runs between two tokens are a single space or a newline, which isn't worth setting up a vector for, so
+        // the first couple of characters are checked one by one.
+        constexpr usize ScalarPrelude = 2;
+
+        const char* ptr = begin;
+        for (const char* prelude_end = begin + std::min<usize>(end - begin, ScalarPrelude); ptr != prelude_end; ++ptr)
+        {
+            if (!IsCharClass(*ptr, Whitespace))
+                return ptr;
+        }
+#if defined(CMC_SCAN_AVX2) || defined(CMC_SCAN_SSE2)
+        while (end - ptr >= (std::ptrdiff_t)VectorSize)
+        {
+            const Vector chunk = Load(ptr);
+            const Vector ws    = Or(Or(Equals(chunk, Splat(' ')), Equals(chunk, Splat('\t'))),
+                                    Or(Equals(chunk, Splat('\r')), Equals(chunk, Splat('\n'))));
+
+            const Mask non_ws = ~MoveMask(ws) & FullMask;
+            if (non_ws != 0)
+                return ptr + std::countr_zero(non_ws);
+            ptr += VectorSize;
+        }
+#endif
+        while (ptr != end && IsCharClass(*ptr, Whitespace))
+            ++ptr;
+        return ptr;
+    }
+
+    const char* SkipIdentifierBody(const char* begin, const char* end) noexcept
+    {
+        const char* ptr = begin;
+#if defined(CMC_SCAN_AVX2) || defined(CMC_SCAN_SSE2)
+        while (end - ptr >= (std::ptrdiff_t)VectorSize)
+        {
+            const Vector chunk = Load(ptr);
+
+            // Setting the 0x20 bit folds upper case letters onto lower case ones.
+            const Vector letter = InRange(Or(chunk, Splat(0x20)), 'a', 'z');
+            const Vector ident  = Or(Or(letter, InRange(chunk, '0', '9')), Equals(chunk, Splat('_')));
+
+            const Mask non_ident = ~MoveMask(ident) & FullMask;
+            if (non_ident != 0)
+                return ptr + std::countr_zero(non_ident);
+            ptr += VectorSize;
+        }
+#endif
+        while (ptr != end && IsCharClass(*ptr, IdentifierBody))
+            ++ptr;
+        return ptr;
+    }
+
+    const char* FindChar(const char* begin, const char* end, const char c) noexcept
+    {
+        const char* ptr = begin;
+#if defined(CMC_SCAN_AVX2) || defined(CMC_SCAN_SSE2)
+        const Vector needle = Splat(c);
+        while (end - ptr >= (std::ptrdiff_t)VectorSize)
+        {
+            const Mask found = MoveMask(Equals(Load(ptr), needle));
+            if (found != 0)
+                return ptr + std::countr_zero(found);
+            ptr += VectorSize;
+        }
+#endif
+        while (ptr != end && *ptr != c)
+            ++ptr;
+        return ptr;
+    }
+
+    const char* FindEitherChar(const char* begin, const char* end, const char a, const char b) noexcept
+    {
+        const char* ptr = begin;
+#if defined(CMC_SCAN_AVX2) || defined(CMC_SCAN_SSE2)
+        const Vector needle_a = Splat(a);
+        const Vector needle_b = Splat(b);
+        while (end - ptr >= (std::ptrdiff_t)VectorSize)
+        {
+            const Vector chunk = Load(ptr);
+            const Mask   found = MoveMask(Or(Equals(chunk, needle_a), Equals(chunk, needle_b)));
+            if (found != 0)
+                return ptr + std::countr_zero(found);
+            ptr += VectorSize;
+        }
+#endif
+        while (ptr != end && *ptr != a && *ptr != b)
+            ++ptr;
+        return ptr;
+    }
+
+    void FindAllChars(const char* begin, const char* end, const char c, std::vector<u32>& positions)
+    {
+        const char* ptr = begin;
+#if defined(CMC_SCAN_AVX2) || defined(CMC_SCAN_SSE2)
+        const Vector needle = Splat(c);
+        while (end - ptr >= (std::ptrdiff_t)VectorSize)
+        {
+            // Walk the set bits of the mask, clearing the lowest one each time.
+            for (Mask found = MoveMask(Equals(Load(ptr), needle)); found != 0; found &= found - 1)
+                positions.push_back((u32)(ptr - begin + std::countr_zero(found)));
+            ptr += VectorSize;
+        }
+#endif
+        for (; ptr != end; ++ptr)
+        {
+            if (*ptr == c)
+                positions.push_back((u32)(ptr - begin));
+        }
+    }
+} // namespace cmm::cmc
@@ -0,0 +1,62 @@
+#ifndef CMC_ANALYZER_CHAR_SCAN_H
+#define CMC_ANALYZER_CHAR_SCAN_H
+
+#include <array>
+#include <vector>
+
+#include <CommonDef.h>
+
+namespace cmm::cmc {
+    // Character classes as bit flags, a character can belong to several of them.
+    enum CharClass : u8
+    {
+        Whitespace      = 1 << 0,
+        Newline         = 1 << 1,
+        Digit           = 1 << 2,
+        IdentifierStart = 1 << 3,
+        IdentifierBody  = 1 << 4
+    };
+
+    // Locale independent classification of every possible byte. Anything outside of ASCII belongs to no class.
+    constexpr std::array<u8, 256> CharClassTable = []() {
+        std::array<u8, 256> table{};
+        table[' ']  = Whitespace;
+        table['\t'] = Whitespace;
+        table['\r'] = Whitespace;
+        table['\n'] = Whitespace | Newline;
+        for (usize c = '0'; c <= '9'; ++c)
+            table[c] = Digit | IdentifierBody;
+        for (usize c = 'a'; c <= 'z'; ++c)
+        {
+            table[c]             = IdentifierStart | IdentifierBody;
+            table[c - 'a' + 'A'] = IdentifierStart | IdentifierBody;
+        }
+        table['_'] = IdentifierStart | IdentifierBody;
+        return table;
+    }();
+
+    constexpr bool IsCharClass(const char c, const u8 cls) noexcept
+    {
+        return (CharClassTable[(u8)c] & cls) != 0;
+    }
+
+    // Bulk scanners over [begin, end). They use SSE2 (or AVX2 if the compiler targets it) on x86 and fall back to a
+    // table driven scalar loop elsewhere and for the tail of the range. None of them ever reads past end.
+
+    // Returns the first non-whitespace character.
+    const char* SkipWhitespace(const char* begin, const char* end) noexcept;
+
+    // Returns the first character that cannot be part of an identifier.
+    const char* SkipIdentifierBody(const char* begin, const char* end) noexcept;
+
+    // Returns the first occurrence of c or end if there's none.
+    const char* FindChar(const char* begin, const char* end, const char c) noexcept;
+
+    // Returns the first occurrence of either a or b or end if there's none.
+    const char* FindEitherChar(const char* begin, const char* end, const char a, const char b) noexcept;
+
+    // Appends the offset (from begin) of every occurrence of c to positions.
+    void FindAllChars(const char* begin, const char* end, const char c, std::vector<u32>& positions);
+} // namespace cmm::cmc
+
+#endif // CMC_ANALYZER_CHAR_SCAN_H
@@ -0,0 +1,259 @@
+#include "ConstantFolder.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace cmm::cmc::ast {
+    namespace {
+        // Brings a value computed with 64 bits back into the range of its type, the way the result would wrap
+        // around if it was computed at that width.
+        i64 Wrap(const u64 value, const TypeId type) noexcept
+        {
+            switch (TypeOf(type).ftype)
+            {
+                case FundamentalType::Integer32: return (i64)(i32)(u32)value;
+                case FundamentalType::Boolean: return value != 0;
+                default: break;
+            }
+            return (i64)value;
+        }
+
+        bool IsOperation(const StatementKind kind) noexcept
+        {
+            using enum StatementKind;
+
+            switch (kind)
+            {
+                case EqualsExpression:
+                case NotEqualsExpression:
+                case GreaterExpression:
+                case GreaterThanExpression:
+                case LesserExpression:
+                case LesserThanExpression:
+                case GreaterThanOrEqualExpression:
+                case LesserThanOrEqualExpression:
+                case AdditionExpression:
+                case SubtractionExpression:
+                case MultiplicationExpression:
+                case DivisionExpression:
+                case LogicalAndExpression:
+                case LogicalOrExpression:
+                case LogicalNotExpression:
+                case NegationExpression: return true;
+                default: break;
+            }
+            return false;
+        }
+    } // namespace
+
+    ConstantFolder::ConstantFolder(SyntaxTree& tree) noexcept : m_Tree(tree)
+    {
+    }
+
+    void ConstantFolder::Fold()
+    {
+        m_Pure.assign(m_Tree.Size(), false);
+        for (NodeId id = 0; id < m_Tree.Size(); ++id)
+        {
+            bool folded{};
+            switch (m_Tree[id].kind)
+            {
+                using enum StatementKind;
+
+                case AdditionExpression:
+                case SubtractionExpression:
+                case MultiplicationExpression:
+                case DivisionExpression: folded = FoldArithmetic(id); break;
+
+                case EqualsExpression:
+                case NotEqualsExpression:
+                case GreaterExpression:
+                case GreaterThanExpression:
+                case LesserExpression:
+                case LesserThanExpression:
+                case GreaterThanOrEqualExpression:
+                case LesserThanOrEqualExpression: folded = FoldComparison(id); break;
+
+                case LogicalAndExpression:
+                case LogicalOrExpression: folded = FoldLogical(id); break;
+
+                case LogicalNotExpression:
+                case NegationExpression: folded = FoldUnary(id); break;
+
+                default: break;
+            }
+            m_FoldedCount += folded;
+
+            // Whatever the statement became, its children have been looked at already.
+            const auto kind = m_Tree[id].kind;
+            if (kind == StatementKind::LiteralExpression || kind == StatementKind::IdentifierName)
+                m_Pure[id] = true;
+            else if (IsOperation(kind))
+            {
+                // A division may trap unless what it divides by is known to be safe.
+                const auto children = m_Tree.GetChildren(id);
+                const auto divisor  = (kind == StatementKind::DivisionExpression) ? GetConstant(children[1]) : 1;
+                m_Pure[id] = divisor && *divisor != 0 && *divisor != -1 &&
+                             std::all_of(children.begin(), children.end(), [&](const NodeId c) { return m_Pure[c]; });
+            }
+        }
+    }
+
+    bool ConstantFolder::FoldArithmetic(const NodeId id)
+    {
+        const auto& expr = m_Tree[id];
+        const auto  lhs  = m_Tree.GetChild(id, 0);
+        const auto  rhs  = m_Tree.GetChild(id, 1);
+        const auto  l    = GetConstant(lhs);
+        const auto  r    = GetConstant(rhs);
+        if (l && r)
+        {
+            const auto a = (u64)*l;
+            const auto b = (u64)*r;
+            switch (expr.kind)
+            {
+                using enum StatementKind;
+
+                case AdditionExpression: m_Tree.ReplaceWithLiteral(id, Wrap(a + b, expr.type)); return true;
+                case SubtractionExpression: m_Tree.ReplaceWithLiteral(id, Wrap(a - b, expr.type)); return true;
+                case MultiplicationExpression: m_Tree.ReplaceWithLiteral(id, Wrap(a * b, expr.type)); return true;
+                case DivisionExpression: {
+                    // Whatever dividing by zero or overflowing does is left for run time.
+                    if (*r == 0 || (*l == std::numeric_limits<i64>::min() && *r == -1))
+                        return false;
+                    m_Tree.ReplaceWithLiteral(id, Wrap((u64)(*l / *r), expr.type));
+                    return true;
+                }
+                default: return false;
+            }
+        }
+
+        // An operand only gets dropped if evaluating it does nothing else.
+        switch (expr.kind)
+        {
+            using enum StatementKind;
+
+            case AdditionExpression:
+                if (r == 0)
+                    m_Tree.Replace(id, lhs);
+                else if (l == 0)
+                    m_Tree.Replace(id, rhs);
+                else
+                    return false;
+                return true;
+            case SubtractionExpression:
+            case DivisionExpression:
+                if (r == (expr.kind == SubtractionExpression ? 0 : 1))
+                {
+                    m_Tree.Replace(id, lhs);
+                    return true;
+                }
+                return false;
+            case MultiplicationExpression:
+                if (r == 1)
+                    m_Tree.Replace(id, lhs);
+                else if (l == 1)
+                    m_Tree.Replace(id, rhs);
+                else if ((r == 0 && m_Pure[lhs]) || (l == 0 && m_Pure[rhs]))
+                    m_Tree.ReplaceWithLiteral(id, 0);
+                else
+                    return false;
+                return true;
+            default: break;
+        }
+        return false;
+    }
+
+    bool ConstantFolder::FoldComparison(const NodeId id)
+    {
+        const auto l = GetConstant(m_Tree.GetChild(id, 0));
+        const auto r = GetConstant(m_Tree.GetChild(id, 1));
+        if (!l || !r)
+            return false;
+
+        bool result{};
+        switch (m_Tree[id].kind)
+        {
+            using enum StatementKind;
+
+            case EqualsExpression: result = *l == *r; break;
+            case NotEqualsExpression: result = *l != *r; break;
+            case GreaterExpression: result = *l > *r; break;
+            case LesserExpression: result = *l < *r; break;
+            case GreaterThanExpression:
+            case GreaterThanOrEqualExpression: result = *l >= *r; break;
+            case LesserThanExpression:
+            case LesserThanOrEqualExpression: result = *l <= *r; break;
+            default: return false;
+        }
+        m_Tree.ReplaceWithLiteral(id, result);
+        return true;
+    }
+
+    bool ConstantFolder::FoldLogical(const NodeId id)
+    {
+        const auto lhs = m_Tree.GetChild(id, 0);
+        const auto rhs = m_Tree.GetChild(id, 1);
+        const auto l   = GetConstant(lhs);
+        const auto r   = GetConstant(rhs);
+        if (l && r)
+        {
+            const bool is_and = m_Tree[id].kind == StatementKind::LogicalAndExpression;
+            m_Tree.ReplaceWithLiteral(id, is_and ? (*l && *r) : (*l || *r));
+            return true;
+        }
+
+        // The operand that decides on its own is 0 for `&&` and 1 for `||`, the other one is the identity.
+        const i64 identity = (m_Tree[id].kind == StatementKind::LogicalAndExpression) ? 1 : 0;
+        const i64 decisive = 1 - identity;
+        if (l == identity)
+            m_Tree.Replace(id, rhs);
+        else if (r == identity)
+            m_Tree.Replace(id, lhs);
+        else if ((l == decisive && m_Pure[rhs]) || (r == decisive && m_Pure[lhs]))
+            m_Tree.ReplaceWithLiteral(id, decisive);
+        else
+            return false;
+        return true;
+    }
+
+    bool ConstantFolder::FoldUnary(const NodeId id)
+    {
+        const auto& expr    = m_Tree[id];
+        const auto  operand = m_Tree.GetChild(id, 0);
+        if (const auto value = GetConstant(operand))
+        {
+            if (expr.kind == StatementKind::NegationExpression)
+                m_Tree.ReplaceWithLiteral(id, Wrap(0 - (u64)*value, expr.type));
+            else
+                m_Tree.ReplaceWithLiteral(id, *value == 0);
+            return true;
+        }
+
+        // Negating or inverting twice gives back what we started with.
+        if (m_Tree[operand].kind == expr.kind)
+        {
+            m_Tree.Replace(id, m_Tree.GetChild(operand, 0));
+            return true;
+        }
+        return false;
+    }
+
+    std::optional<i64> ConstantFolder::GetConstant(const NodeId id) const noexcept
+    {
+        if (m_Tree[id].kind != StatementKind::LiteralExpression)
+            return std::nullopt;
+
+        switch (TypeOf(m_Tree[id].type).ftype)
+        {
+            using enum FundamentalType;
+
+            case Boolean:
+            case Character:
+            case Integer32:
+            case Integer64: return m_Tree.GetLiteralValue(id);
+            default: break;
+        }
+        return std::nullopt;
+    }
+} // namespace cmm::cmc::ast
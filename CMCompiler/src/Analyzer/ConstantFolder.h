@@ -0,0 +1,40 @@
+#ifndef CMC_ANALYZER_CONSTANT_FOLDER_H
+#define CMC_ANALYZER_CONSTANT_FOLDER_H
+
+#include <optional>
+#include <vector>
+
+#include "Parser.h"
+
+namespace cmm::cmc::ast {
+    // Evaluates expressions whose operands are all known at compile time and drops operations that leave their operand
+    // as it is, like `x + 0` or `x * 1`, rewriting the statements right in the tree. Arithmetic wraps around at the
+    // width of its type like it does at run time. A statement always comes after its children in the tree, so a single
+    // pass in id order sees every operand folded before the operation using it.
+    class ConstantFolder
+    {
+    private:
+        SyntaxTree&       m_Tree;
+        std::vector<bool> m_Pure{}; // Whether evaluating a statement has no effect besides its value.
+        usize             m_FoldedCount{};
+
+    public:
+        explicit ConstantFolder(SyntaxTree& tree) noexcept;
+
+    public:
+        void Fold();
+
+        // How many expressions were evaluated or simplified away.
+        inline usize GetFoldedCount() const noexcept { return m_FoldedCount; }
+
+    private:
+        // Each returns whether it rewrote the statement.
+        bool               FoldArithmetic(const NodeId id);
+        bool               FoldComparison(const NodeId id);
+        bool               FoldLogical(const NodeId id);
+        bool               FoldUnary(const NodeId id);
+        std::optional<i64> GetConstant(const NodeId id) const noexcept;
+    };
+} // namespace cmm::cmc::ast
+
+#endif // CMC_ANALYZER_CONSTANT_FOLDER_H
@@ -0,0 +1,110 @@
+#include "Document.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace cmm::cmc {
+    namespace {
+        // Where a token starts in the source. The text of string and character literals leaves out the opening quote
+        // and Eof sits right at the end.
+        usize TokenStart(const TokenType type, const usize offset) noexcept
+        {
+            return (type == TokenType::StringLiteral || type == TokenType::CharacterLiteral) ? offset - 1 : offset;
+        }
+
+        usize TokenStart(const Token& token, const std::string_view source) noexcept
+        {
+            return (token.type == TokenType::Eof) ? source.size() : TokenStart(token.type, token.span.offset);
+        }
+    } // namespace
+
+    Document::Document(std::string text) : m_Text(std::move(text))
+    {
+        auto lexer = Lexer(m_Text);
+        lexer.SetStringTable(nullptr);
+        m_Tokens = lexer.TokenizeAll();
+    }
+
+    Document::Document(Document&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    Document& Document::operator=(Document&& other) noexcept
+    {
+        if (this != &other)
+        {
+            // A (possibly small string optimized) text does not necessarily keep its address when moved.
+            m_Text   = std::move(other.m_Text);
+            m_Tokens = std::move(other.m_Tokens);
+            m_Tokens.Rebind(m_Text);
+        }
+        return *this;
+    }
+
+    TokenEdit Document::Edit(const usize offset, const usize length, const std::string_view text)
+    {
+        assert(offset + length <= m_Text.size());
+
+        const auto& offsets  = m_Tokens.GetOffsets();
+        const i64   delta    = (i64)text.size() - (i64)length;
+        const usize new_end  = offset + text.size();
+        const usize old_size = m_Text.size();
+
+        // Where the old tokens started, before the edit.
+        const auto old_start = [&](const usize idx) {
+            const auto type = m_Tokens.GetType(idx);
+            return (type == TokenType::Eof) ? old_size : TokenStart(type, offsets[idx]);
+        };
+
+        // The last token starting before the edit might grow into it (think of typing at the end of an identifier), so
+        // that's where lexing starts again. Literals start one before their offset, which only makes this safer.
+        usize first   = std::lower_bound(offsets.begin(), offsets.end(), (u32)offset) - offsets.begin();
+        usize restart = 0;
+        if (first > 0)
+            restart = old_start(--first);
+
+        const std::string removed = m_Text.substr(offset, length);
+        m_Text.replace(offset, length, text);
+        m_Tokens.Rebind(m_Text);
+
+        // Lex until a token past the edit starts exactly where an old one did. The text from there on is unchanged so
+        // lexing it again would produce the very same tokens.
+        auto        lexer = Lexer(m_Text, restart);
+        TokenStream fresh{ m_Text };
+        lexer.SetStringTable(nullptr);
+        usize       last = first;
+        try
+        {
+            for (auto token = lexer.NextToken(); token.has_value(); token = lexer.NextToken())
+            {
+                const usize start = TokenStart(*token, m_Text);
+                if (start >= new_end)
+                {
+                    const usize start_before = (usize)((i64)start - delta);
+                    while (last < m_Tokens.Size() && old_start(last) < start_before)
+                        ++last;
+                    if (last < m_Tokens.Size() && old_start(last) == start_before)
+                        break;
+                }
+
+                fresh.Push(*token);
+                if (token->type == TokenType::Eof)
+                {
+                    last = m_Tokens.Size();
+                    break;
+                }
+            }
+        }
+        catch (...)
+        {
+            // Leave the document as it was if the edited text doesn't lex.
+            m_Text.replace(offset, text.size(), removed);
+            m_Tokens.Rebind(m_Text);
+            throw;
+        }
+
+        m_Tokens.Splice(first, last, fresh, delta);
+        return TokenEdit{ .first = first, .removed = last - first, .inserted = fresh.Size() };
+    }
+} // namespace cmm::cmc
@@ -0,0 +1,52 @@
+#ifndef CMC_ANALYZER_DOCUMENT_H
+#define CMC_ANALYZER_DOCUMENT_H
+
+#include <string>
+#include <string_view>
+
+#include <CommonDef.h>
+
+#include "Lexer.h"
+
+namespace cmm::cmc {
+    // Which tokens an edit replaced: [first, first + removed) of the old stream became [first, first + inserted).
+    struct TokenEdit
+    {
+        usize first{};
+        usize removed{};
+        usize inserted{};
+    };
+
+    // An editable source buffer that keeps its token stream up to date. Editors apply every keystroke as an edit and
+    // only the tokens around it get lexed again: lexing restarts at the last token boundary before the edit and stops
+    // as soon as it lands on the start of a token past the edit that was already there before, from which point on
+    // the old tokens are reused as is.
+    //
+    // Identifiers aren't interned, every partial name typed would otherwise stay in the global string table for good.
+    // Their tokens carry no SymbolId, TokenStream::InternIdentifiers() hands them out when the stream gets parsed.
+    class Document
+    {
+    private:
+        std::string m_Text{};
+        TokenStream m_Tokens{};
+
+    public:
+        explicit Document(std::string text);
+        Document(const Document&) = delete;
+        Document(Document&& other) noexcept;
+
+    public:
+        Document& operator=(const Document&) = delete;
+        Document& operator=(Document&& other) noexcept;
+
+    public:
+        inline std::string_view   GetText() const noexcept { return m_Text; }
+        inline const TokenStream& GetTokens() const noexcept { return m_Tokens; }
+
+    public:
+        // Replaces length bytes starting at offset with text.
+        TokenEdit Edit(const usize offset, const usize length, const std::string_view text);
+    };
+} // namespace cmm::cmc
+
+#endif // CMC_ANALYZER_DOCUMENT_H
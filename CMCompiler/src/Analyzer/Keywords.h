@@ -0,0 +1,114 @@
+#ifndef CMC_ANALYZER_KEYWORDS_H
+#define CMC_ANALYZER_KEYWORDS_H
+
+#include <algorithm>
+#include <array>
+#include <string_view>
+
+#include <CommonDef.h>
+
+#include "Lexer.h"
+
+namespace cmm::cmc {
+    // How the lexer tells keywords apart from identifiers, in a header so the benchmarks can measure it on its own.
+    struct Keyword
+    {
+        std::string_view spelling{};
+        TokenType        type{};
+    };
+
+    // Every keyword of the language, add new ones here. The static_assert below will tell you if the new keyword
+    // collides with an existing one in which case KeywordHash() needs tweaking.
+    inline constexpr std::array<Keyword, 14> Keywords = {
+        Keyword{ "let", TokenType::KeywordLet },       Keyword{ "fn", TokenType::KeywordFn },
+        Keyword{ "import", TokenType::KeywordImport }, Keyword{ "if", TokenType::KeywordIf },
+        Keyword{ "else", TokenType::KeywordElse },     Keyword{ "while", TokenType::KeywordWhile },
+        Keyword{ "i32", TokenType::KeywordI32 },       Keyword{ "i64", TokenType::KeywordI64 },
+        Keyword{ "string", TokenType::KeywordString }, Keyword{ "bool", TokenType::KeywordBool },
+        Keyword{ "char", TokenType::KeywordChar },     Keyword{ "return", TokenType::KeywordReturn },
+        Keyword{ "true", TokenType::KeywordTrue },     Keyword{ "false", TokenType::KeywordFalse }
+    };
+
+    inline constexpr usize KeywordSlotCount = 64;
+
+    // Perfect hash over the keyword set built from the length and the first and last characters, which is all it
+    // takes to tell our keywords apart.
+    constexpr usize KeywordHash(const std::string_view str) noexcept
+    {
+        return (str.size() + (u8)str.front() * 3 + (u8)str.back()) & (KeywordSlotCount - 1);
+    }
+
+    constexpr u32 Load32(const char* ptr) noexcept
+    {
+        return (u32)(u8)ptr[0] | (u32)(u8)ptr[1] << 8 | (u32)(u8)ptr[2] << 16 | (u32)(u8)ptr[3] << 24;
+    }
+
+    // Keywords are short enough to be compared as a single integer instead of a memcmp(). Together with the length
+    // the fingerprint is exact for anything up to 8 characters: two overlapping 4 byte loads cover the whole
+    // string and anything shorter is just its first, middle and last characters.
+    constexpr u64 Fingerprint(const std::string_view str) noexcept
+    {
+        const usize size = str.size();
+        if (size >= 4)
+            return (u64)Load32(str.data()) | (u64)Load32(str.data() + size - 4) << 32;
+        return (u64)(u8)str[0] | (u64)(u8)str[size / 2] << 8 | (u64)(u8)str[size - 1] << 16;
+    }
+
+    inline constexpr usize MaxKeywordLength = []() {
+        usize max = 0;
+        for (const auto& kw : Keywords)
+            max = std::max(max, kw.spelling.size());
+        return max;
+    }();
+    static_assert(MaxKeywordLength <= 8, "Keywords longer than 8 characters do not fit in a fingerprint.");
+
+    struct KeywordSlot
+    {
+        u64       fingerprint{};
+        usize     length{};
+        TokenType type = TokenType::Identifier;
+    };
+
+    // Every hash slot holds the fingerprint of the keyword that maps to it, or nothing.
+    inline constexpr auto KeywordSlots = []() {
+        std::array<KeywordSlot, KeywordSlotCount> slots{};
+        for (const auto& kw : Keywords)
+        {
+            auto& slot       = slots[KeywordHash(kw.spelling)];
+            slot.fingerprint = Fingerprint(kw.spelling);
+            slot.length      = kw.spelling.size();
+            slot.type        = kw.type;
+        }
+        return slots;
+    }();
+
+    constexpr bool KeywordHashIsPerfect() noexcept
+    {
+        for (const auto& kw : Keywords)
+        {
+            if (KeywordSlots[KeywordHash(kw.spelling)].type != kw.type)
+                return false;
+        }
+        return true;
+    }
+    static_assert(KeywordHashIsPerfect(), "Two keywords share the same hash slot, adjust KeywordHash().");
+
+    // Returns the keyword's token type or Identifier if ident is not a keyword. Costs a hash, a table load and an
+    // integer comparison.
+    constexpr TokenType KeywordOrIdentifier(const std::string_view ident) noexcept
+    {
+        if (ident.empty())
+            return TokenType::Identifier;
+
+        const auto& slot = KeywordSlots[KeywordHash(ident)];
+        return (slot.length == ident.size() && slot.fingerprint == Fingerprint(ident)) ? slot.type
+                                                                                        : TokenType::Identifier;
+    }
+    static_assert(KeywordOrIdentifier("return") == TokenType::KeywordReturn);
+    static_assert(KeywordOrIdentifier("fn") == TokenType::KeywordFn);
+    static_assert(KeywordOrIdentifier("returns") == TokenType::Identifier);
+    static_assert(KeywordOrIdentifier("retn") == TokenType::Identifier);
+    static_assert(KeywordOrIdentifier("returnreturn") == TokenType::Identifier);
+} // namespace cmm::cmc
+
+#endif // CMC_ANALYZER_KEYWORDS_H
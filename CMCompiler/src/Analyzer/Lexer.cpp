@@ -1,9 +1,80 @@
 #include "Lexer.h"
 
-#include <cctype>
+#include "CharScan.h"
+#include "Keywords.h"
+
 #include <cstdlib>
+#include <future>
+#include <thread>
 
 namespace cmm::cmc {
+    namespace {
+        // Splits source into at most count pieces of roughly the same size that can be lexed independently. Tokens
+        // never span a newline unless they're a literal, and a literal is the only place a newline can hide in, so
+        // every piece but the last one ends right after a newline that is outside of any literal.
+        //
+        // Whether a newline is inside a literal depends on everything before it so the quotes are walked from the
+        // start, which is still far cheaper than lexing. Outside of a string a single quote always opens a character
+        // literal spanning exactly three characters, and a double quote opens a string running until the next one.
+        std::vector<std::string_view> SplitAtSafeNewlines(const std::string_view source, const usize count)
+        {
+            const char* begin = source.data();
+            const char* end   = begin + source.size();
+
+            std::vector<std::string_view> pieces{};
+            pieces.reserve(count);
+
+            // Never inside of a literal.
+            const char* ptr         = begin;
+            const char* piece_begin = begin;
+            for (usize i = 1; i < count && ptr != end; ++i)
+            {
+                const char* target = begin + source.size() * i / count;
+                const char* split  = nullptr;
+                while (ptr != end)
+                {
+                    // [ptr, quote) has no literals in it, split at its first newline past the target if there's one.
+                    const char* quote = FindEitherChar(ptr, end, '"', '\'');
+                    if (quote > target)
+                    {
+                        const char* new_line = FindChar(std::max(ptr, target), quote, '\n');
+                        if (new_line != quote)
+                        {
+                            split = new_line + 1;
+                            ptr   = split;
+                            break;
+                        }
+                    }
+
+                    // Step over the literal.
+                    if (quote == end)
+                        ptr = end;
+                    else if (*quote == '"')
+                        ptr = std::min(FindChar(quote + 1, end, '"') + 1, end);
+                    else
+                        ptr = quote + std::min<usize>(3, end - quote);
+                }
+
+                if (split != nullptr && split != end)
+                {
+                    pieces.emplace_back(piece_begin, split - piece_begin);
+                    piece_begin = split;
+                }
+            }
+            pieces.emplace_back(piece_begin, end - piece_begin);
+            return pieces;
+        }
+
+        // Pieces are lexed concurrently so interning is left to the stitching, which also keeps the ids in the same
+        // order a serial lex would hand them out in.
+        TokenStream LexPiece(const std::string_view piece)
+        {
+            auto lexer = Lexer(piece);
+            lexer.SetStringTable(nullptr);
+            return lexer.TokenizeAll();
+        }
+    } // namespace
+
     std::string_view TokenTypeToString(const TokenType type) noexcept
     {
         static const char* str[] = { "None",
@@ -30,16 +101,144 @@ namespace cmm::cmc {
         return str[(usize)type];
     }
 
+    TokenStream::TokenStream(const std::string_view source) noexcept : m_Source(source)
+    {
+    }
+
+    void TokenStream::Reserve(const usize count)
+    {
+        m_Types.reserve(count);
+        m_Offsets.reserve(count);
+        m_Lengths.reserve(count);
+        m_Values.reserve(count);
+    }
+
+    void TokenStream::Push(const Token& token)
+    {
+        // Tokens without any text (Eof) still get an offset, the end of the source.
+        const usize offset = (token.span.text.data() != nullptr) ? token.span.text.data() - m_Source.data()
+                                                                 : m_Source.size();
+
+        m_Types.push_back(token.type);
+        m_Offsets.push_back((u32)offset);
+        m_Lengths.push_back((u32)token.span.text.size());
+        m_Values.push_back(token.num);
+    }
+
+    void TokenStream::AppendSlice(const TokenStream& slice)
+    {
+        const usize base  = slice.m_Source.data() - m_Source.data();
+        const usize count = slice.Size() - 1;
+
+        m_Types.insert(m_Types.end(), slice.m_Types.begin(), slice.m_Types.begin() + count);
+        m_Lengths.insert(m_Lengths.end(), slice.m_Lengths.begin(), slice.m_Lengths.begin() + count);
+        m_Values.insert(m_Values.end(), slice.m_Values.begin(), slice.m_Values.begin() + count);
+        for (usize i = 0; i < count; ++i)
+            m_Offsets.push_back((u32)(slice.m_Offsets[i] + base));
+    }
+
+    void TokenStream::Splice(const usize first, const usize last, const TokenStream& replacement, const i64 delta)
+    {
+        // Grow or shrink the hole to the right size first so the tail only moves once.
+        const auto replace = [&](auto& dst, const auto& src) {
+            if (src.size() > last - first)
+                dst.insert(dst.begin() + last, src.size() - (last - first), {});
+            else
+                dst.erase(dst.begin() + first + src.size(), dst.begin() + last);
+            std::copy(src.begin(), src.end(), dst.begin() + first);
+        };
+        replace(m_Types, replacement.m_Types);
+        replace(m_Offsets, replacement.m_Offsets);
+        replace(m_Lengths, replacement.m_Lengths);
+        replace(m_Values, replacement.m_Values);
+
+        // Everything after the replaced tokens is the same text as before, it just moved.
+        for (usize i = first + replacement.Size(); i < Size(); ++i)
+            m_Offsets[i] = (u32)(m_Offsets[i] + delta);
+    }
+
+    void TokenStream::InternIdentifiers(StringTable& strings)
+    {
+        for (usize i = 0; i < Size(); ++i)
+        {
+            if (m_Types[i] == TokenType::Identifier)
+                m_Values[i] = strings.Intern(m_Source.substr(m_Offsets[i], m_Lengths[i]));
+        }
+    }
+
+    Token TokenStream::Get(const usize idx) const noexcept
+    {
+        // Anything past the end is the trailing Eof token.
+        const usize i = std::min(idx, Size() - 1);
+        return Token{ .type = m_Types[i],
+                      .span = TextSpan{ .offset = m_Offsets[i], .text = m_Source.substr(m_Offsets[i], m_Lengths[i]) },
+                      .num  = m_Values[i] };
+    }
+
     Lexer::Lexer(const std::string_view source) : m_Source(source)
     {
     }
 
-    std::optional<Token> Lexer::PeekToken()
+    Lexer::Lexer(const std::string_view source, const usize start)
+        : m_Source(source), m_CurrentPos(start)
+    {
+    }
+
+    TokenStream Lexer::TokenizeAll()
+    {
+        TokenStream stream{ m_Source };
+
+        // Generated sources average around six bytes per token so this avoids most of the regrowth without
+        // overcommitting too much for whitespace heavy inputs.
+        stream.Reserve(m_Source.size() / 8);
+
+        for (auto token = NextToken(); token.has_value(); token = NextToken())
+        {
+            stream.Push(*token);
+            if (token->type == TokenType::Eof)
+                break;
+        }
+        return stream;
+    }
+
+    TokenStream Lexer::TokenizeParallel(usize workers)
     {
-        const auto current_state = *this;
-        auto       token         = NextToken();
-        *this                    = std::move(current_state);
-        return token;
+        if (workers == 0)
+            workers = std::max(1u, std::thread::hardware_concurrency());
+
+        const usize count = std::min(workers, m_Source.size() / MinParallelChunkSize);
+        if (count <= 1)
+            return TokenizeAll();
+
+        // The first piece is lexed on the calling thread while the workers take care of the rest.
+        const auto                            pieces = SplitAtSafeNewlines(m_Source, count);
+        std::vector<std::future<TokenStream>> futures{};
+        futures.reserve(pieces.size());
+        for (usize i = 1; i < pieces.size(); ++i)
+            futures.push_back(std::async(std::launch::async, LexPiece, pieces[i]));
+
+        std::vector<TokenStream> lexed{};
+        lexed.reserve(pieces.size());
+        lexed.push_back(LexPiece(pieces[0]));
+
+        // Collecting the results in source order rethrows the error the serial lexer would've run into first.
+        usize total = lexed[0].Size();
+        for (auto& f : futures)
+        {
+            lexed.push_back(f.get());
+            total += lexed.back().Size();
+        }
+
+        TokenStream stream{ m_Source };
+        stream.Reserve(total);
+        for (const auto& piece : lexed)
+            stream.AppendSlice(piece);
+        stream.Push(Token{ .type = TokenType::Eof });
+        if (m_Strings != nullptr)
+            stream.InternIdentifiers(*m_Strings);
+
+        m_CurrentPos = m_Source.size() + 1;
+        return stream;
     }
 
     std::optional<Token> Lexer::NextToken()
@@ -54,76 +253,37 @@ namespace cmm::cmc {
             // Now we're past the end.
             return std::nullopt;
 
+        // Skip whitespace and friends in bulk.
+        const char* source_end = m_Source.data() + m_Source.size();
+        const char* ws_end     = SkipWhitespace(m_Source.data() + m_CurrentPos, source_end);
+        Advance(ws_end - (m_Source.data() + m_CurrentPos));
+
         auto  c             = CurrentChar();
         usize start         = m_CurrentPos;
         auto  current_token = Token{};
 
-        // Skip whitespace and friends
-        while (c.has_value() && (*c == ' ' || *c == '\t' || *c == '\n' || *c == '\r'))
-        {
-            // Consume the whitespace.
-            Consume();
-
-            if (*c == '\n')
-                // If it's a line then increment the line count.
-                ++m_LineCount;
-
-            // Progress to the next character and update start.
-            c     = CurrentChar();
-            start = m_CurrentPos;
-        }
-
         // If our current character is valid.
         if (c.has_value())
         {
             // If it's a number start.
-            if (std::isdigit(*c))
+            if (IsCharClass(*c, Digit))
             {
                 // Consume the number and set the type.
                 current_token.num  = ConsumeNumber();
                 current_token.type = TokenType::NumberLiteral;
             }
-            else if (IsIdentifierStart(*c)) // Else if it's a possible identifier.
+            else if (IsCharClass(*c, IdentifierStart)) // Else if it's a possible identifier.
             {
                 auto ident = ConsumeIdentifier();
 
-                // Check if it's a keyword.
-                if (ident == "let")
-                    current_token.type = TokenType::KeywordLet;
-                else if (ident == "fn")
-                    current_token.type = TokenType::KeywordFn;
-                else if (ident == "import")
-                    current_token.type = TokenType::KeywordImport;
-                else if (ident == "if")
-                    current_token.type = TokenType::KeywordIf;
-                else if (ident == "else")
-                    current_token.type = TokenType::KeywordElse;
-                else if (ident == "while")
-                    current_token.type = TokenType::KeywordWhile;
-                else if (ident == "i32")
-                    current_token.type = TokenType::KeywordI32;
-                else if (ident == "i64")
-                    current_token.type = TokenType::KeywordI64;
-                else if (ident == "string")
-                    current_token.type = TokenType::KeywordString;
-                else if (ident == "bool")
-                    current_token.type = TokenType::KeywordBool;
-                else if (ident == "char")
-                    current_token.type = TokenType::KeywordChar;
-                else if (ident == "return")
-                    current_token.type = TokenType::KeywordReturn;
-                else if (ident == "false")
-                {
-                    current_token.type = TokenType::KeywordFalse;
-                    current_token.num  = 0;
-                }
-                else if (ident == "true")
-                {
-                    current_token.type = TokenType::KeywordTrue;
-                    current_token.num  = 1;
-                }
-                else
-                    current_token.type = TokenType::Identifier;
+                // Check if it's a keyword, booleans carry their value along and identifiers their interned name.
+                current_token.type = KeywordOrIdentifier(ident);
+                if (current_token.type == TokenType::Identifier && m_Strings != nullptr)
+                    current_token.num = m_Strings->Intern(ident);
+                else if (current_token.type == TokenType::KeywordTrue)
+                    current_token.num = 1;
+                else if (current_token.type == TokenType::KeywordFalse)
+                    current_token.num = 0;
             }
             else // Else it must be an operator.
             {
@@ -139,12 +299,10 @@ namespace cmm::cmc {
                         // This is always going to be true but whatever I guess.
                         if (str.has_value())
                         {
-                            // Since we know it's a string we can just handle it right away and move str into our token
-                            // span.
-                            ++m_TokenCount;
+                            // Since we know it's a string we can just handle it right away, the span's text being the
+                            // contents between the quotes.
                             current_token.type = TokenType::StringLiteral;
-                            current_token.span =
-                                TextSpan{ .line = m_LineCount, .cur = m_TokenCount, .text = std::move(*str) };
+                            current_token.span = TextSpan{ .offset = (u32)(start + 1), .text = *str };
 
                             return current_token;
                         }
@@ -152,7 +310,8 @@ namespace cmm::cmc {
                     }
                     case TokenType::Quote: {
                         // Consume the possible character inside the single quotes.
-                        auto c = Consume();
+                        const usize char_pos = m_CurrentPos;
+                        auto        c        = Consume();
                         if (c.has_value())
                         {
                             // Consume the possible second quote.
@@ -160,11 +319,10 @@ namespace cmm::cmc {
                             if (ec == '\'')
                             {
                                 // Since we know it's a character we can just handle it right away.
-                                ++m_TokenCount;
                                 current_token.type = TokenType::CharacterLiteral;
                                 current_token.num  = *ec;
-                                current_token.span = TextSpan{ .line = m_LineCount, .cur = m_TokenCount };
-                                current_token.span.text += *c;
+                                current_token.span =
+                                    TextSpan{ .offset = (u32)char_pos, .text = m_Source.substr(char_pos, 1) };
 
                                 return current_token;
                             }
@@ -184,13 +342,9 @@ namespace cmm::cmc {
             return Token{ .type = TokenType::Eof };
         }
 
-        // Increment the token count and create our text span which will hold the line number, cursor number and the
-        // text itself.
-        ++m_TokenCount;
+        // Create our text span which holds where the token starts and the text itself.
         usize end          = m_CurrentPos;
-        current_token.span = TextSpan{ .line = m_LineCount,
-                                       .cur  = m_TokenCount,
-                                       .text = std::string{ m_Source.substr(start, end - start) } };
+        current_token.span = TextSpan{ .offset = (u32)start, .text = m_Source.substr(start, end - start) };
 
         return current_token;
     }
@@ -214,40 +368,34 @@ namespace cmm::cmc {
         return c;
     }
 
+    void Lexer::Advance(const usize count) noexcept
+    {
+        m_CurrentPos += count;
+    }
+
     i64 Lexer::ConsumeNumber() noexcept
     {
         // Consume the number digit by digit until we hit a non-digit character.
         i64 num = 0;
-        for (auto c = CurrentChar(); c.has_value(); c = CurrentChar())
+        while (m_CurrentPos < m_Source.size() && IsCharClass(m_Source[m_CurrentPos], Digit))
         {
-            if (std::isdigit(*c))
-            {
-                // If c was valid then Consume the current character then store c into num.
-                Consume();
-                num = num * 10 + (*c - '0');
-            }
-            else
-                break;
+            num = num * 10 + (m_Source[m_CurrentPos] - '0');
+            Advance(1);
         }
         return num;
     }
 
-    std::string Lexer::ConsumeIdentifier() noexcept
+    std::string_view Lexer::ConsumeIdentifier() noexcept
     {
-        std::string ident{};
-        for (auto c = CurrentChar(); c.has_value(); c = CurrentChar())
-        {
-            if ((ident.empty() && std::isalpha(*c)) || (!ident.empty() && std::isalnum(*c)) || *c == '_')
-            {
-                // If our identifier starts with a letter or contains a possible letter or a number, or it's just an
-                // underscore then Consume the current character, append the previous to ident, then continue.
-                Consume();
-                ident += *c;
-            }
-            else
-                break;
-        }
-        return ident;
+        // We already know the first character is an identifier start (a letter or an underscore) so from there on
+        // anything that's a letter, a number or an underscore belongs to the identifier.
+        const usize start     = m_CurrentPos;
+        const char* end       = m_Source.data() + m_Source.size();
+        const char* ident_end = SkipIdentifierBody(m_Source.data() + start + 1, end);
+        Advance(ident_end - (m_Source.data() + start));
+
+        // The identifier is just a view into the source, no need to copy it.
+        return m_Source.substr(start, m_CurrentPos - start);
     }
 
     TokenType Lexer::ConsumeOperator() noexcept
@@ -336,6 +484,14 @@ namespace cmm::cmc {
                     }
                 }
                 return Bar;
+            case '&':
+                // There's no single ampersand operator (yet).
+                if (p.has_value() && *p == '&')
+                {
+                    Consume();
+                    return AmpersasndAmpersand;
+                }
+                break;
             case '<':
                 if (p.has_value())
                 {
@@ -370,36 +526,30 @@ namespace cmm::cmc {
         return TokenType::None;
     }
 
-    std::optional<std::string> Lexer::ConsumeString() noexcept
+    std::optional<std::string_view> Lexer::ConsumeString() noexcept
     {
-        std::string str{};
-        for (auto c = CurrentChar(); c.has_value(); c = CurrentChar())
-        {
-            // Consume the string until we hit a double quote.
-            Consume();
-            if (*c != '"')
-                str += *c;
-            else
-                break;
-        }
-
-        // If the string was invalid then return nothing, or str otherwise.
-        if (str.empty())
+        // There are no escape sequences (yet) so the contents of a string literal are exactly the characters between
+        // the quotes and we can hand out a view into the source instead of building a copy.
+        const usize start = m_CurrentPos;
+        const char* end   = m_Source.data() + m_Source.size();
+        const usize quote = FindChar(m_Source.data() + start, end, '"') - m_Source.data();
+
+        // Consume the contents and the closing quote if there's one, an unterminated string runs until the end.
+        Advance(quote - start);
+        if (m_CurrentPos < m_Source.size())
+            Advance(1);
+
+        // If the string was invalid then return nothing, or the string's contents otherwise.
+        if (quote == start)
             return std::nullopt;
         else
-            return str;
-    }
-
-    bool Lexer::IsIdentifierStart(const char c) const noexcept
-    {
-        // Identifiers start with a letter or an underscore followed by more letters, underscores and numbers.
-        return (std::isalpha(c) || c == '_');
+            return m_Source.substr(start, quote - start);
     }
 } // namespace cmm::cmc
 
 std::ostream& operator<<(std::ostream& stream, const cmm::cmc::TextSpan& span) noexcept
 {
-    stream << "{ Text: '" << span.text << "', Line: " << span.line << ", Cursor: " << span.cur << " }";
+    stream << "{ Text: '" << span.text << "', Offset: " << span.offset << " }";
     return stream;
 }
 
@@ -1,6 +1,7 @@
 #ifndef CMC_ANALYZER_LEXER_H
 #define CMC_ANALYZER_LEXER_H
 
+#include <algorithm>
 #include <iostream>
 #include <nlohmann/json.hpp>
 #include <optional>
@@ -9,6 +10,8 @@
 
 #include <CommonDef.h>
 
+#include "StringTable.h"
+
 namespace cmm::cmc {
     enum class TokenType : u32
     {
@@ -85,11 +88,13 @@ namespace cmm::cmc {
 
     std::string_view TokenTypeToString(const TokenType type) noexcept;
 
+    // The text of a span is a view into the source buffer handed to the Lexer, so that buffer must outlive every
+    // token (and every statement holding one) produced from it. Lines and columns are not tracked while lexing, a
+    // LineIndex over the same source turns the offset into one when a diagnostic needs it.
     struct TextSpan
     {
-        usize       line{};
-        usize       cur{};
-        std::string text{};
+        u32              offset{};
+        std::string_view text{};
     };
 
     struct Token
@@ -97,7 +102,7 @@ namespace cmm::cmc {
     public:
         TokenType type = TokenType::None;
         TextSpan  span{};
-        i64       num{};
+        i64       num{}; // The value of literals and the interned SymbolId of identifiers.
 
     public:
         // Few handy methods to make parsing easier.
@@ -170,34 +175,99 @@ namespace cmm::cmc {
             return false;
         }
         std::string_view ToString() const noexcept { return TokenTypeToString(type); }
+        SymbolId         GetSymbolId() const noexcept { return (SymbolId)num; }
     };
 
     using TokenList = std::vector<Token>;
 
+    class AstCache;
+
+    // The whole token stream of a source buffer laid out as parallel arrays, produced in a single pass by
+    // Lexer::TokenizeAll(). Consumers walk it by index and materialize a Token only when they need one. The stream
+    // always ends with an Eof token and reading past the end keeps returning it.
+    class TokenStream
+    {
+    private:
+        std::string_view       m_Source{};
+        std::vector<TokenType> m_Types{};
+        std::vector<u32>       m_Offsets{}; // Where the token's text starts in the source.
+        std::vector<u32>       m_Lengths{}; // Length of the token's text.
+        std::vector<i64>       m_Values{};  // Number literal, character and boolean values.
+
+        // Writes the arrays out and reads them back as they are.
+        friend class AstCache;
+
+    public:
+        TokenStream() = default;
+        explicit TokenStream(const std::string_view source) noexcept;
+
+    public:
+        inline std::string_view GetSource() const noexcept { return m_Source; }
+        inline usize            Size() const noexcept { return m_Types.size(); }
+        inline TokenType        GetType(const usize idx) const noexcept { return m_Types[std::min(idx, Size() - 1)]; }
+
+    public:
+        // Where every token's text starts, in ascending order.
+        inline const std::vector<u32>& GetOffsets() const noexcept { return m_Offsets; }
+
+        // Points the stream at a different buffer, used by Document after the text has been edited.
+        inline void Rebind(const std::string_view source) noexcept { m_Source = source; }
+
+    public:
+        void  Reserve(const usize count);
+        void  Push(const Token& token);
+        Token Get(const usize idx) const noexcept;
+
+        // Appends the tokens of a stream that was lexed from a slice of our source, all but its trailing Eof. Offsets
+        // are rebased onto our source.
+        void AppendSlice(const TokenStream& slice);
+
+        // Replaces the tokens [first, last) with every token of replacement and moves the offsets of the tokens from
+        // last on by delta. The replacement must have been lexed from the buffer this stream points to.
+        void Splice(const usize first, const usize last, const TokenStream& replacement, const i64 delta);
+
+        // Interns the text of every identifier and stores its SymbolId as the token's value.
+        void InternIdentifiers(StringTable& strings);
+    };
+
     class Lexer
     {
+    public:
+        // TokenizeParallel() never hands a worker less than this many bytes, smaller sources are lexed in one go.
+        static constexpr usize MinParallelChunkSize = 1 << 20;
+
     private:
         std::string_view m_Source{};
         usize            m_CurrentPos{};
-        usize            m_TokenCount{};
-        usize            m_LineCount = 1;
+        StringTable*     m_Strings = &StringTable::Global();
 
     public:
         Lexer() = default;
         explicit Lexer(const std::string_view source);
 
+        // Starts lexing at start instead of the beginning, which must be where a token starts or whitespace before one.
+        Lexer(const std::string_view source, const usize start);
+
+    public:
+        // Where identifiers get interned, nowhere if null. Defaults to the global table.
+        inline void SetStringTable(StringTable* strings) noexcept { m_Strings = strings; }
+
     public:
         std::optional<Token> NextToken();
-        std::optional<Token> PeekToken();
+        TokenStream          TokenizeAll();
+
+        // Produces exactly what TokenizeAll() does but splits the source at newlines that are outside of any literal
+        // and lexes the pieces on up to workers threads, or as many as the hardware has if workers is zero.
+        TokenStream TokenizeParallel(usize workers = 0);
 
     private:
-        std::optional<char>        CurrentChar() const noexcept;
-        std::optional<char>        Consume() noexcept;
-        i64                        ConsumeNumber() noexcept;
-        std::string                ConsumeIdentifier() noexcept;
-        TokenType                  ConsumeOperator() noexcept;
-        std::optional<std::string> ConsumeString() noexcept;
-        bool                       IsIdentifierStart(const char c) const noexcept;
+        std::optional<char>             CurrentChar() const noexcept;
+        std::optional<char>             Consume() noexcept;
+        void                            Advance(const usize count) noexcept;
+        i64                             ConsumeNumber() noexcept;
+        std::string_view                ConsumeIdentifier() noexcept;
+        TokenType                       ConsumeOperator() noexcept;
+        std::optional<std::string_view> ConsumeString() noexcept;
     };
 
 } // namespace cmm::cmc
@@ -277,9 +347,8 @@ namespace nlohmann {
     {
         static void to_json(ordered_json& j, const cmm::cmc::TextSpan& t)
         {
-            j["line"] = t.line;
-            j["cur"]  = t.cur;
-            j["text"] = t.text;
+            j["offset"] = t.offset;
+            j["text"]   = t.text;
         }
     };
 
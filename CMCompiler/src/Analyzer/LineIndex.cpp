@@ -0,0 +1,24 @@
+#include "LineIndex.h"
+
+#include "CharScan.h"
+
+#include <algorithm>
+
+namespace cmm::cmc {
+    LineIndex::LineIndex(const std::string_view source)
+    {
+        // The first line starts at the beginning and every other one right after a newline.
+        m_LineStarts.reserve(source.size() / 32 + 1);
+        m_LineStarts.push_back(0);
+        FindAllChars(source.data(), source.data() + source.size(), '\n', m_LineStarts);
+        std::for_each(m_LineStarts.begin() + 1, m_LineStarts.end(), [](u32& start) { ++start; });
+    }
+
+    SourceLocation LineIndex::Locate(const usize offset) const noexcept
+    {
+        // The line is the last one starting at or before offset.
+        const auto it   = std::upper_bound(m_LineStarts.begin(), m_LineStarts.end(), offset) - 1;
+        const auto line = (usize)(it - m_LineStarts.begin());
+        return SourceLocation{ .line = line + 1, .column = offset - *it + 1 };
+    }
+} // namespace cmm::cmc
@@ -0,0 +1,37 @@
+#ifndef CMC_ANALYZER_LINE_INDEX_H
+#define CMC_ANALYZER_LINE_INDEX_H
+
+#include <string_view>
+#include <vector>
+
+#include <CommonDef.h>
+
+namespace cmm::cmc {
+    // Both line and column start at one, the column being counted in bytes.
+    struct SourceLocation
+    {
+        usize line{};
+        usize column{};
+    };
+
+    // Maps byte offsets of a source buffer to lines and columns. Tokens only carry their offset and locations are
+    // only ever needed for diagnostics, so this is built on demand with a single newline scan and every lookup is a
+    // binary search over the line starts.
+    class LineIndex
+    {
+    private:
+        std::vector<u32> m_LineStarts{};
+
+    public:
+        LineIndex() = default;
+        explicit LineIndex(const std::string_view source);
+
+    public:
+        inline usize GetLineCount() const noexcept { return m_LineStarts.size(); }
+
+    public:
+        SourceLocation Locate(const usize offset) const noexcept;
+    };
+} // namespace cmm::cmc
+
+#endif // CMC_ANALYZER_LINE_INDEX_H
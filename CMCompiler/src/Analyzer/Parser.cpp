@@ -1,243 +1,648 @@
 #include "Parser.h"
 
+#include <algorithm>
+#include <array>
+#include <future>
+#include <thread>
+
 // TODO: Improve and instead use exceptions.
-#define CompileError(token, ...)                                                                                       \
-    std::cerr << fmt::format("Compile Error @ line ({}, {}): ", (token).span.line, (token).span.cur)                   \
-              << fmt::format(__VA_ARGS__) << std::endl;                                                                \
-    std::exit(-1);
+#define CompileError(token, ...) ReportError(token, fmt::format(__VA_ARGS__))
 
 namespace cmm::cmc {
     using namespace ast;
 
-    namespace ast {
-        Type Type::Integer32 = Type{ .name = "Integer32", .ftype = FundamentalType::Integer32, .size = 32 };
-        Type Type::Integer64 = Type{ .name = "Integer64", .ftype = FundamentalType::Integer64, .size = 64 };
-        Type Type::Character = Type{ .name = "Character8", .ftype = FundamentalType::Character, .size = 8 };
-        Type Type::Boolean   = Type{ .name = "Boolean", .ftype = FundamentalType::Boolean, .size = 8 };
+    namespace {
+        // What the operands of an operator have to be. Integer and Boolean operators also require both operands of a
+        // binary operator to be of the same type, Matching ones only that.
+        enum class OperandRule : u8
+        {
+            Integer,
+            Boolean,
+            Matching
+        };
+
+        struct OperatorInfo
+        {
+            StatementKind kind{};
+            u8            power{}; // How tightly the operator binds, 0 for tokens that aren't one.
+            OperandRule   operands{};
+        };
+
+        using OperatorTable = std::array<OperatorInfo, (usize)TokenType::Eof + 1>;
+
+        // Binary operators by token, all of them left associative. Adding one only takes an entry here and a kind.
+        constexpr OperatorTable BinaryOperators = [] {
+            using enum StatementKind;
+
+            OperatorTable table{};
+            table[(usize)TokenType::BarBar]              = { LogicalOrExpression, 10, OperandRule::Boolean };
+            table[(usize)TokenType::AmpersasndAmpersand] = { LogicalAndExpression, 20, OperandRule::Boolean };
+            table[(usize)TokenType::EqualsEquals]        = { EqualsExpression, 30, OperandRule::Matching };
+            table[(usize)TokenType::ExclamationEquals]   = { NotEqualsExpression, 30, OperandRule::Matching };
+            table[(usize)TokenType::RightAngleBracket]   = { GreaterExpression, 30, OperandRule::Matching };
+            table[(usize)TokenType::LeftAngleBracket]    = { LesserExpression, 30, OperandRule::Matching };
+            table[(usize)TokenType::GreaterThanEquals]   = { GreaterThanExpression, 30, OperandRule::Matching };
+            table[(usize)TokenType::LesserThanEquals]    = { LesserThanExpression, 30, OperandRule::Matching };
+            table[(usize)TokenType::Plus]                = { AdditionExpression, 40, OperandRule::Integer };
+            table[(usize)TokenType::Minus]               = { SubtractionExpression, 40, OperandRule::Integer };
+            table[(usize)TokenType::Asterisk]            = { MultiplicationExpression, 50, OperandRule::Integer };
+            table[(usize)TokenType::ForwardSlash]        = { DivisionExpression, 50, OperandRule::Integer };
+            return table;
+        }();
+
+        // Prefix operators by token, they bind tighter than any binary operator.
+        constexpr OperatorTable PrefixOperators = [] {
+            using enum StatementKind;
+
+            OperatorTable table{};
+            table[(usize)TokenType::Minus]       = { NegationExpression, 60, OperandRule::Integer };
+            table[(usize)TokenType::Exclamation] = { LogicalNotExpression, 60, OperandRule::Boolean };
+            return table;
+        }();
+
+        bool SatisfiesRule(const OperandRule rule, const TypeId type) noexcept
+        {
+            switch (rule)
+            {
+                case OperandRule::Integer:
+                    return TypeOf(type).ftype == FundamentalType::Integer32 ||
+                           TypeOf(type).ftype == FundamentalType::Integer64;
+                case OperandRule::Boolean: return type == TypeTable::Boolean;
+                default: break;
+            }
+            return true;
+        }
+
+        // Where every top level function declaration starts followed by where the last one ends, found by matching the
+        // curly braces of their bodies. Nothing if the top level is anything but a run of `fn ... { ... }`, in which
+        // case only the serial parse knows where the functions end, or what's wrong with them.
+        std::optional<std::vector<usize>> FindFunctionBoundaries(const TokenStream& tokens)
+        {
+            std::vector<usize> bounds{};
+            usize              i = 0;
+            while (tokens.GetType(i) != TokenType::Eof)
+            {
+                if (tokens.GetType(i) != TokenType::KeywordFn)
+                    return std::nullopt;
+                bounds.push_back(i++);
+
+                // The signature can't contain a statement or another function.
+                for (; tokens.GetType(i) != TokenType::LeftCurlyBrace; ++i)
+                {
+                    switch (tokens.GetType(i))
+                    {
+                        case TokenType::Eof:
+                        case TokenType::KeywordFn:
+                        case TokenType::SemiColon:
+                        case TokenType::RightCurlyBrace: return std::nullopt;
+                        default: break;
+                    }
+                }
+
+                usize depth = 0;
+                do
+                {
+                    switch (tokens.GetType(i++))
+                    {
+                        case TokenType::LeftCurlyBrace: ++depth; break;
+                        case TokenType::RightCurlyBrace: --depth; break;
+                        case TokenType::Eof: return std::nullopt;
+                        default: break;
+                    }
+                } while (depth > 0);
+            }
+            bounds.push_back(i);
+            return bounds;
+        }
+    } // namespace
 
-        Type Type::String(const Token& string_token) noexcept
+    namespace ast {
+        Token SyntaxTree::GetToken(const NodeId id, const usize idx) const noexcept
         {
-            auto type = Type{ .name = "CString", .ftype = FundamentalType::String };
-            type.size = string_token.span.text.size();
-            return type;
+            const auto& stmt = m_Statements[id];
+            if (idx >= stmt.token_count)
+                return Token{};
+            return m_Tokens->Get(m_TokenRefs[stmt.first_token + idx]);
         }
 
-        std::optional<Token> Statement::GetToken(const TokenType& type) const noexcept
+        std::optional<Token> SyntaxTree::FindToken(const NodeId id, const TokenType type) const noexcept
         {
-            for (const auto& t : tokens)
+            const auto& stmt = m_Statements[id];
+            for (usize i = stmt.first_token; i < stmt.first_token + stmt.token_count; ++i)
             {
-                if (t.type == type)
-                    return t;
+                if (m_Tokens->GetType(m_TokenRefs[i]) == type)
+                    return m_Tokens->Get(m_TokenRefs[i]);
             }
             return std::nullopt;
         }
+
+        i64 SyntaxTree::GetLiteralValue(const NodeId id) const noexcept
+        {
+            if (IsFoldedLiteral(id))
+                return m_Constants[m_Statements[id].first_token];
+            return GetToken(id, 0).num;
+        }
+
+        void SyntaxTree::SetTokenStream(TokenStream tokens)
+        {
+            m_Tokens = std::make_shared<const TokenStream>(std::move(tokens));
+        }
+
+        void SyntaxTree::ShareTokenStream(const SyntaxTree& tree) noexcept
+        {
+            m_Tokens = tree.m_Tokens;
+        }
+
+        NodeId SyntaxTree::Add(Statement stmt, const std::span<const NodeId> children,
+                               const std::span<const u32> tokens)
+        {
+            stmt.first_child = (u32)m_Children.size();
+            stmt.child_count = (u32)children.size();
+            stmt.first_token = (u32)m_TokenRefs.size();
+            stmt.token_count = (u32)tokens.size();
+            m_Children.insert(m_Children.end(), children.begin(), children.end());
+            m_TokenRefs.insert(m_TokenRefs.end(), tokens.begin(), tokens.end());
+            m_Statements.push_back(std::move(stmt));
+            return (NodeId)(m_Statements.size() - 1);
+        }
+
+        void SyntaxTree::AddGlobal(const NodeId id)
+        {
+            m_Globals.push_back(id);
+        }
+
+        void SyntaxTree::Replace(const NodeId id, const NodeId with) noexcept
+        {
+            m_Statements[id] = m_Statements[with];
+        }
+
+        void SyntaxTree::ReplaceWithLiteral(const NodeId id, const i64 value)
+        {
+            auto& stmt       = m_Statements[id];
+            stmt.kind        = StatementKind::LiteralExpression;
+            stmt.child_count = 0;
+            stmt.first_token = (u32)m_Constants.size();
+            stmt.token_count = 0;
+            m_Constants.push_back(value);
+        }
+
+        void SyntaxTree::Append(const SyntaxTree& part)
+        {
+            // The part's statements, children and tokens all go after ours so its ranges and ids just shift.
+            const auto node_offset  = (NodeId)m_Statements.size();
+            const auto child_offset = (u32)m_Children.size();
+            const auto token_offset = (u32)m_TokenRefs.size();
+            const auto value_offset = (u32)m_Constants.size();
+
+            m_Statements.reserve(m_Statements.size() + part.m_Statements.size());
+            for (NodeId id = 0; id < part.m_Statements.size(); ++id)
+            {
+                auto stmt = part.m_Statements[id];
+                stmt.first_child += child_offset;
+                stmt.first_token += part.IsFoldedLiteral(id) ? value_offset : token_offset;
+                m_Statements.push_back(stmt);
+            }
+
+            m_Children.reserve(m_Children.size() + part.m_Children.size());
+            for (const auto child : part.m_Children)
+                m_Children.push_back(child + node_offset);
+
+            m_TokenRefs.insert(m_TokenRefs.end(), part.m_TokenRefs.begin(), part.m_TokenRefs.end());
+            m_Constants.insert(m_Constants.end(), part.m_Constants.begin(), part.m_Constants.end());
+            for (const auto id : part.m_Globals)
+                m_Globals.push_back(id + node_offset);
+        }
     } // namespace ast
 
-    void SymbolTable::AddSymbol(Symbol symbol) noexcept
+    Parser::Parser(const std::string_view source) noexcept : m_Source(source)
     {
-        m_Symbols[symbol.name] = std::move(symbol);
     }
 
-    bool SymbolTable::ContainsSymbol(const std::string& name) const noexcept
+    Parser::Parser(TokenStream tokens) noexcept : m_Source(tokens.GetSource()), m_Tokens(std::move(tokens))
     {
-        return m_Symbols.contains(name);
     }
 
-    Symbol& SymbolTable::GetSymbol(const std::string& name) noexcept
+    SyntaxTree Parser::Parse() &&
     {
-        return m_Symbols[name];
+        TakeTokens();
+        ParseSerially();
+        return std::move(m_Tree);
     }
 
-    const Symbol& SymbolTable::GetSymbol(const std::string& name) const noexcept
+    SyntaxTree Parser::ParseParallel(usize workers) &&
     {
-        return ((SymbolTable*)this)->GetSymbol(name);
+        TakeTokens();
+        if (workers == 0)
+            workers = std::max(1u, std::thread::hardware_concurrency());
+
+        const auto& tokens = GetTokens();
+        const auto  bounds = FindFunctionBoundaries(tokens);
+        const usize count =
+            bounds ? std::min({ workers, tokens.Size() / m_MinParallelTokenCount, bounds->size() - 1 }) : 0;
+        if (count <= 1)
+        {
+            ParseSerially();
+            return std::move(m_Tree);
+        }
+
+        // A call can refer to any function declared before it, so every worker needs to know the signatures of the
+        // functions before its own.
+        const auto signatures = ParseSignatures(*bounds);
+        if (!signatures)
+        {
+            ParseSerially();
+            return std::move(m_Tree);
+        }
+
+        // Hand every worker a run of whole functions with about the same number of tokens.
+        std::vector<std::pair<usize, usize>> runs{};
+        usize                                first = 0;
+        for (usize i = 1; i < bounds->size(); ++i)
+        {
+            const usize target = tokens.Size() * (runs.size() + 1) / count;
+            if ((*bounds)[i] >= target || i == bounds->size() - 1)
+            {
+                runs.emplace_back(first, i);
+                first = i;
+            }
+        }
+
+        // The first run is parsed on the calling thread while the workers take care of the rest.
+        const auto parse_run = [&](const std::pair<usize, usize> run) {
+            return ParseFunctions((*bounds)[run.first], (*bounds)[run.second],
+                                  std::span{ *signatures }.first(run.first));
+        };
+        std::vector<std::future<std::optional<SyntaxTree>>> futures{};
+        futures.reserve(runs.size());
+        for (usize i = 1; i < runs.size(); ++i)
+            futures.push_back(std::async(std::launch::async, parse_run, runs[i]));
+
+        std::vector<std::optional<SyntaxTree>> parts{};
+        parts.reserve(runs.size());
+        parts.push_back(parse_run(runs[0]));
+        for (auto& f : futures)
+            parts.push_back(f.get());
+
+        // Any error is left to the serial parse, which reports the first one in the source like it always has.
+        if (std::any_of(parts.begin(), parts.end(), [](const auto& part) { return !part.has_value(); }))
+        {
+            ParseSerially();
+            return std::move(m_Tree);
+        }
+
+        // Merging the parts in source order numbers every statement exactly like the serial parse would have.
+        for (auto& part : parts)
+        {
+            m_Tree.Append(*part);
+            part.reset();
+        }
+        return std::move(m_Tree);
     }
 
-    std::optional<Type> Type::FromToken(const Token& token) noexcept
+    std::optional<SyntaxTree> Parser::ParseNextFunction()
     {
-        switch (token.type)
+        if (!m_Started)
         {
-            using enum TokenType;
-
-            case KeywordI32: return Type::Integer32;
-            case KeywordI64: return Type::Integer64;
-            case KeywordString: return Type::String(token);
-            case KeywordChar: return Type::Character;
-            case KeywordBool: return Type::Boolean;
-            case Identifier: return Type{ .name = token.span.text, .ftype = FundamentalType::UserDefined };
-            default: break;
+            TakeTokens();
+            m_Started      = true;
+            m_TokenIndex   = 0;
+            m_CurrentToken = GetTokens().Get(m_TokenIndex);
+        }
+
+        while (m_CurrentToken.IsValid())
+        {
+            if (auto c = ExpectFunctionDecl(); c.has_value())
+            {
+                m_Tree.AddGlobal(*c);
+
+                // The next function starts out in a tree of its own, only the token stream carries over.
+                SyntaxTree next{};
+                next.ShareTokenStream(m_Tree);
+                return std::exchange(m_Tree, std::move(next));
+            }
         }
         return std::nullopt;
     }
 
-    Parser::Parser(const std::string_view source) noexcept : m_Source(source)
+    void Parser::TakeTokens()
     {
+        // Tokenize the whole source up front unless we were handed an already tokenized stream.
+        if (m_Tokens.Size() == 0)
+            m_Tokens = Lexer(m_Source).TokenizeAll();
+
+        // The tree refers to its tokens by index so it takes the stream over, and diagnostics look tokens up through
+        // it while parsing.
+        m_Tree.SetTokenStream(std::move(m_Tokens));
     }
 
-    std::vector<Statement> Parser::Parse()
+    void Parser::ParseSerially()
     {
-        m_Lexer        = Lexer(m_Source);
-        m_CurrentToken = m_Lexer.NextToken();
-        while (m_CurrentToken->IsValid())
+        m_TokenIndex   = 0;
+        m_CurrentToken = GetTokens().Get(m_TokenIndex);
+        while (m_CurrentToken.IsValid())
         {
             if (auto c = ExpectFunctionDecl(); c.has_value())
-                m_GlobalStatements.push_back(std::move(*c));
+                m_Tree.AddGlobal(*c);
+        }
+    }
+
+    Parser Parser::MakeWorker(const usize first) const
+    {
+        // A worker reads our tokens and puts what it parses in a tree of its own.
+        Parser worker{ m_Source };
+        worker.m_SharedTokens       = &GetTokens();
+        worker.m_ThrowErrors        = true;
+        worker.m_MaxExpressionDepth = m_MaxExpressionDepth;
+        worker.m_TokenIndex         = first;
+        worker.m_CurrentToken       = worker.GetTokens().Get(first);
+        return worker;
+    }
+
+    std::optional<std::vector<Parser::NamedSignature>> Parser::ParseSignatures(
+        const std::span<const usize> bounds) const
+    {
+        // Only the parameter lists and return types are parsed, the bodies are skipped over.
+        std::vector<NamedSignature> signatures{};
+        signatures.reserve(bounds.size() - 1);
+        for (usize i = 0; i + 1 < bounds.size(); ++i)
+        {
+            if (GetTokens().GetType(bounds[i] + 1) != TokenType::Identifier)
+                return std::nullopt;
+
+            auto worker = MakeWorker(bounds[i] + 2);
+            try
+            {
+                worker.m_Symbols.PushScope();
+                const auto params = worker.ExpectFunctionParameterList();
+                if (!worker.m_CurrentToken.IsValid())
+                    return std::nullopt;
+
+                auto& [name, signature] = signatures.emplace_back();
+                name                    = GetTokens().Get(bounds[i] + 1).GetSymbolId();
+                signature.type          = worker.ExpectReturnType();
+                for (const auto param : worker.m_Tree.GetChildren(params))
+                    signature.parameters.push_back(worker.m_Tree[param].type);
+            }
+            catch (const ParseError&)
+            {
+                return std::nullopt;
+            }
+        }
+        return signatures;
+    }
+
+    std::optional<SyntaxTree> Parser::ParseFunctions(const usize first, const usize last,
+                                                     const std::span<const NamedSignature> earlier) const
+    {
+        auto worker = MakeWorker(first);
+        for (const auto& [name, signature] : earlier)
+            worker.m_Functions.Declare(name, signature);
+
+        try
+        {
+            while (worker.m_TokenIndex < last)
+            {
+                const auto fn = worker.ExpectFunctionDecl();
+                if (!fn)
+                    return std::nullopt;
+                worker.m_Tree.AddGlobal(*fn);
+            }
+        }
+        catch (const ParseError&)
+        {
+            return std::nullopt;
         }
-        return m_GlobalStatements;
+
+        // Stopping anywhere but where the pre-pass said the functions end means it got them wrong.
+        if (worker.m_TokenIndex != last)
+            return std::nullopt;
+        return std::move(worker.m_Tree);
     }
 
-    std::optional<Token> Parser::Consume() noexcept
+    Token Parser::Consume() noexcept
     {
         auto current   = m_CurrentToken;
-        m_CurrentToken = m_Lexer.NextToken();
+        m_CurrentToken = GetTokens().Get(++m_TokenIndex);
         return current;
     }
 
-    std::optional<Token> Parser::Peek() noexcept
+    Token Parser::ConsumeAndKeep()
+    {
+        // The token becomes one of the tokens of the statement currently being parsed.
+        m_PendingTokens.push_back((u32)m_TokenIndex);
+        return Consume();
+    }
+
+    Token Parser::Peek(const usize k) const noexcept
+    {
+        // The whole source is already tokenized so this is all the lookahead there is, k tokens are just an index
+        // away.
+        return GetTokens().Get(m_TokenIndex + k);
+    }
+
+    const TokenStream& Parser::GetTokens() const noexcept
+    {
+        // The stream belongs to the tree from the moment parsing starts, workers read the one of their parent's.
+        return m_SharedTokens ? *m_SharedTokens : m_Tree.GetTokenStream();
+    }
+
+    Token Parser::GetStatementToken(const NodeId id, const usize idx) const noexcept
+    {
+        const auto refs = m_Tree.GetTokenRefs(id);
+        return (idx < refs.size()) ? GetTokens().Get(refs[idx]) : Token{};
+    }
+
+    void Parser::ReportError(const Token& token, const std::string& message) const
+    {
+        const auto location = Locate(token);
+        auto diagnostic = fmt::format("Compile Error @ line ({}, {}): {}", location.line, location.column, message);
+        if (m_ThrowErrors)
+            throw ParseError(diagnostic);
+
+        std::cerr << diagnostic << std::endl;
+        std::exit(-1);
+    }
+
+    SourceLocation Parser::Locate(const Token& token) const
+    {
+        if (!m_LineIndex)
+            m_LineIndex.emplace(m_Source);
+        return m_LineIndex->Locate(token.span.offset);
+    }
+
+    Parser::PendingMark Parser::Mark() const noexcept
+    {
+        return PendingMark{ .children = m_PendingChildren.size(), .tokens = m_PendingTokens.size() };
+    }
+
+    NodeId Parser::Finish(const PendingMark& mark, Statement stmt)
     {
-        return m_Lexer.PeekToken();
+        const auto children = std::span<const NodeId>{ m_PendingChildren }.subspan(mark.children);
+        const auto tokens   = std::span<const u32>{ m_PendingTokens }.subspan(mark.tokens);
+        const auto id       = m_Tree.Add(std::move(stmt), children, tokens);
+        m_PendingChildren.resize(mark.children);
+        m_PendingTokens.resize(mark.tokens);
+        return id;
     }
 
-    std::optional<Statement> Parser::GetStatement(const StatementKind kind) const noexcept
+    std::optional<NodeId> Parser::GetStatement(const StatementKind kind) const noexcept
     {
-        for (const auto& e : m_GlobalStatements)
+        for (const auto id : m_Tree.GetGlobals())
         {
-            if (e.kind == kind)
-                return e;
+            if (m_Tree[id].kind == kind)
+                return id;
         }
         return std::nullopt;
     }
 
-    std::optional<Statement> Parser::ExpectFunctionDecl()
+    std::optional<NodeId> Parser::ExpectFunctionDecl()
     {
-        if (m_CurrentToken->type == TokenType::KeywordFn)
+        if (m_CurrentToken.type == TokenType::KeywordFn)
         {
             // Consume the Fn keyword.
-            auto prev_token = *Consume();
+            auto prev_token = Consume();
 
             // Our function declaration statement.
-            Statement func_stmt{};
+            Statement  func_stmt{};
+            const auto mark = Mark();
 
             // If the following token is an identifier.
-            if (m_CurrentToken->type == TokenType::Identifier)
+            if (m_CurrentToken.type == TokenType::Identifier)
             {
                 // Consume the identifier.
-                prev_token     = *Consume();
-                func_stmt.name = prev_token.span.text;
+                prev_token     = ConsumeAndKeep();
+                func_stmt.name = prev_token.GetSymbolId();
                 func_stmt.kind = StatementKind::FunctionDeclaration;
-                func_stmt.tokens.push_back(std::move(prev_token));
 
-                // The function's parameter list symbol table.
-                m_SymbolTableStack.push_back(SymbolTable{});
+                // The function's parameters get a scope of their own.
+                m_Symbols.PushScope();
 
                 // Parse possible parameter list, if there's none then our parameter list statement will just be empty.
-                auto param_list = ExpectFunctionParameterList();
-                func_stmt.children.push_back(std::move(param_list));
+                m_PendingChildren.push_back(ExpectFunctionParameterList());
 
                 // Parse the possible return type or a function scope start.
-                if (m_CurrentToken->IsValid())
+                if (m_CurrentToken.IsValid())
                 {
-                    // Parse the possible arrow return type specifier.
-                    if (m_CurrentToken->type == TokenType::Minus)
-                    {
-                        // Consume the dash.
-                        Consume();
-
-                        if (m_CurrentToken->IsValid() && m_CurrentToken->type == TokenType::RightAngleBracket)
-                        {
-                            // Consume the arrow.
-                            Consume();
-
-                            auto type_opt = Type::FromToken(*m_CurrentToken);
-                            if (type_opt)
-                            {
-                                // Consume the type.
-                                Consume();
-                                func_stmt.type = std::move(*type_opt);
-                            }
-                            else
-                            {
-                                CompileError(*m_CurrentToken, "Unknown type '{}'.", m_CurrentToken->span.text);
-                            }
-                        }
-                        else
-                        {
-                            CompileError(*m_CurrentToken, "Expected an arrow return type specifier.");
-                        }
-                    }
+                    func_stmt.type = ExpectReturnType();
 
                     // Parse the function body.
                     auto body_stmt = ExpectLocalStatement();
                     if (body_stmt)
-                        func_stmt.children.push_back(std::move(*body_stmt));
+                        m_PendingChildren.push_back(*body_stmt);
                     else
                     {
-                        CompileError(*m_CurrentToken, "Expected a statement.");
+                        CompileError(m_CurrentToken, "Expected a statement.");
                     }
                 }
                 else
                 {
-                    CompileError(*m_CurrentToken,
+                    CompileError(m_CurrentToken,
                                  "Expected a function return type specifier or a function scope start.");
                 }
 
-                // Pop the function's parameter list symbol table.
-                m_SymbolTableStack.pop_back();
+                // Leave the function's parameter scope.
+                m_Symbols.PopScope();
 
-                return func_stmt;
+                // Calls from here on can refer to the function.
+                const auto id = Finish(mark, std::move(func_stmt));
+                DeclareFunction(id);
+                return id;
             }
             else
             {
                 CompileError(prev_token, "Expected an Identifier token but got an {} token.",
-                             m_CurrentToken->ToString());
+                             m_CurrentToken.ToString());
             }
         }
         return std::nullopt;
     }
 
-    Statement Parser::ExpectFunctionParameterList()
+    TypeId Parser::ExpectReturnType()
     {
-        Statement params{};
-        if (m_CurrentToken->type == TokenType::LeftBrace)
+        // Functions without an arrow return type specifier return nothing.
+        TypeId type = TypeTable::Void;
+        if (m_CurrentToken.type == TokenType::Minus)
         {
-            // Consume the left brace.
-            auto prev_token = *Consume();
+            // Consume the dash.
+            Consume();
+
+            if (m_CurrentToken.IsValid() && m_CurrentToken.type == TokenType::RightAngleBracket)
+            {
+                // Consume the arrow.
+                Consume();
+
+                auto type_opt = TypeTable::Global().FromToken(m_CurrentToken);
+                if (type_opt)
+                {
+                    // Consume the type.
+                    Consume();
+                    type = *type_opt;
+                }
+                else
+                {
+                    CompileError(m_CurrentToken, "Unknown type '{}'.", m_CurrentToken.span.text);
+                }
+            }
+            else
+            {
+                CompileError(m_CurrentToken, "Expected an arrow return type specifier.");
+            }
+        }
+        return type;
+    }
 
-            // Our possible parameter.
-            Statement parameter{};
+    void Parser::DeclareFunction(const NodeId fn)
+    {
+        FunctionSignature signature{ .type = m_Tree[fn].type };
+        for (const auto param : m_Tree.GetChildren(m_Tree.GetChild(fn, 0)))
+            signature.parameters.push_back(m_Tree[param].type);
+        m_Functions.Declare(m_Tree[fn].name, std::move(signature));
+    }
+
+    NodeId Parser::ExpectFunctionParameterList()
+    {
+        Statement  params{};
+        const auto mark = Mark();
+        if (m_CurrentToken.type == TokenType::LeftBrace)
+        {
+            // Consume the left brace.
+            auto prev_token = Consume();
 
             // If our token is not eof.
-            while (m_CurrentToken->IsValid())
+            while (m_CurrentToken.IsValid())
             {
                 // Possible parameter definition.
-                if (m_CurrentToken->type == TokenType::Identifier)
+                if (m_CurrentToken.type == TokenType::Identifier)
                 {
+                    // Our parameter.
+                    Statement  parameter{};
+                    const auto param_mark = Mark();
+
                     // Consume the identifier.
-                    auto ident = *Consume();
+                    auto ident = ConsumeAndKeep();
 
-                    parameter.name = ident.span.text;
+                    parameter.name = ident.GetSymbolId();
                     parameter.kind = StatementKind::FunctionParameter;
-                    parameter.tokens.push_back(std::move(ident));
 
                     // Next, we expect the token to be valid and a colon because
                     // types are defined in the following syntax: identifier: type, ...
-                    if (m_CurrentToken->IsValid() && m_CurrentToken.value().type == TokenType::Colon)
+                    if (m_CurrentToken.IsValid() && m_CurrentToken.type == TokenType::Colon)
                     {
                         // Consume the colon.
                         Consume();
 
                         // If the following token is valid and a keyword,
                         // hopefully a type.
-                        if (m_CurrentToken->IsValid() && m_CurrentToken.value().IsKeyword())
+                        if (m_CurrentToken.IsValid() && m_CurrentToken.IsKeyword())
                         {
                             // Consume the possible type token.
-                            auto type_token = *Consume();
+                            auto type_token = Consume();
 
                             // Try and create a type from the token. If we get a nothing then it was not a type
                             // so throw a compile error and exit.
-                            auto type_opt = Type::FromToken(type_token);
+                            auto type_opt = TypeTable::Global().FromToken(type_token);
                             if (type_opt)
-                                parameter.type = std::move(*type_opt);
+                                parameter.type = *type_opt;
                             else
                             {
                                 CompileError(type_token, "Expected a type, instead got a {}", type_token.ToString());
@@ -245,39 +650,40 @@ namespace cmm::cmc {
                         }
                         else
                         {
-                            CompileError(*m_CurrentToken, "Expected a type specifier for the parameter.");
+                            CompileError(m_CurrentToken, "Expected a type specifier for the parameter.");
                         }
                     }
                     else
                     {
-                        CompileError(*m_CurrentToken, "Expected a type specifier for the parameter.");
+                        CompileError(m_CurrentToken, "Expected a type specifier for the parameter.");
                     }
 
-                    // Append our parameter to the function's current symbol table.
-                    m_SymbolTableStack.back().AddSymbol(Symbol{ .name = parameter.name, .statement = parameter });
-
-                    // Finally, push our parameter statement to our parameter list.
-                    params.children.push_back(std::move(parameter));
+                    // Finally, push our parameter statement to our parameter list and append it to the function's
+                    // current symbol table.
+                    const auto name     = parameter.name;
+                    const auto param_id = Finish(param_mark, std::move(parameter));
+                    m_PendingChildren.push_back(param_id);
+                    m_Symbols.Declare(name, param_id);
                 }
-                else if (m_CurrentToken->type == TokenType::Comma)
+                else if (m_CurrentToken.type == TokenType::Comma)
                 {
                     // There are more parameters so just progress forward.
                     Consume();
                 }
-                else if (m_CurrentToken->type == TokenType::RightBrace)
+                else if (m_CurrentToken.type == TokenType::RightBrace)
                 {
                     // We've reached the end so terminate.
                     break;
                 }
                 else
                 {
-                    CompileError(*m_CurrentToken, "Expected a function parameter.");
+                    CompileError(m_CurrentToken, "Expected a function parameter.");
                 }
             }
 
-            if (!m_CurrentToken->IsValid())
+            if (!m_CurrentToken.IsValid())
             {
-                CompileError(*m_CurrentToken, "Expected a closing brace after function parameter list declaration.");
+                CompileError(m_CurrentToken, "Expected a closing brace after function parameter list declaration.");
             }
             else
             {
@@ -288,30 +694,137 @@ namespace cmm::cmc {
         }
         else
         {
-            CompileError(*m_CurrentToken, "Expected a parameter list.");
+            CompileError(m_CurrentToken, "Expected a parameter list.");
         }
-        return params;
+        return Finish(mark, std::move(params));
     }
 
-    std::optional<Statement> Parser::ExpectLocalStatement()
+    std::optional<NodeId> Parser::ExpectLocalStatement()
     {
-        // For keywords and block statements we do not want to check for a
-        // semicolon because, well, block statements end with the closing curly
-        // and keywords such as while and if can be a single statement or
-        // be chained with a block statement which like I stated before, ends with a curly brace.
+        // Blocks, ifs and whiles nest statements inside of them. Rather than recursing for each of them, which runs out
+        // of native stack on deeply nested input, they wait on a stack of our own until their nested statements are
+        // parsed. Block statements end with the closing curly and ifs and whiles end with their body, so none of them
+        // are followed by a semicolon.
+        std::vector<OpenStatement> open{};
+        while (true)
+        {
+            std::optional<NodeId> result{};
+            if (m_CurrentToken.type == TokenType::LeftCurlyBrace)
+            {
+                open.push_back(OpenBlockStatement());
+                continue;
+            }
+            else if (m_CurrentToken.type == TokenType::KeywordIf || m_CurrentToken.type == TokenType::KeywordWhile)
+            {
+                open.push_back(OpenConditionalStatement());
+                continue;
+            }
+            else if (!open.empty() && open.back().stmt.kind == StatementKind::BlockStatement &&
+                     m_CurrentToken.type == TokenType::RightCurlyBrace)
+            {
+                // Consume the closing curly brace.
+                ConsumeAndKeep();
 
-        // Check for a compound statement.
-        auto result = ExpectBlockStatement();
-        if (result)
-            return result;
+                // Leave our compound statement's scope and finish it.
+                m_Symbols.PopScope();
+                result = Finish(open.back().mark, std::move(open.back().stmt));
+                open.pop_back();
+            }
+            else if (!open.empty() && open.back().stmt.kind == StatementKind::BlockStatement &&
+                     !m_CurrentToken.IsValid())
+            {
+                // We met an EOF instead of a closing curly brace.
+                CompileError(m_CurrentToken, "Expected a closing curly brace to end the block statement.");
+            }
+            else
+            {
+                result = ExpectSimpleStatement();
+            }
 
-        // Else check for a keyword statement.
-        if (!result)
+            // Hand the finished statement to the one it's nested in. Ifs and whiles only take a single statement as
+            // their body so that finishes them as well and they get handed on in turn.
+            while (true)
+            {
+                if (open.empty())
+                    return result;
+
+                auto& parent = open.back();
+                if (parent.stmt.kind == StatementKind::BlockStatement)
+                {
+                    if (result)
+                        m_PendingChildren.push_back(*result);
+                    break;
+                }
+
+                if (!result)
+                {
+                    CompileError(parent.body_token, "Expected a body for the {} statement.",
+                                 (parent.stmt.kind == StatementKind::IfStatement) ? "if" : "while");
+                }
+                m_PendingChildren.push_back(*result);
+                result = Finish(parent.mark, std::move(parent.stmt));
+                open.pop_back();
+            }
+        }
+    }
+
+    Parser::OpenStatement Parser::OpenBlockStatement()
+    {
+        // Our compound statement opens a new scope.
+        m_Symbols.PushScope();
+
+        // Our block statement.
+        OpenStatement block{ .stmt = Statement{ .kind = StatementKind::BlockStatement }, .mark = Mark() };
+
+        // Consume the left curly brace.
+        ConsumeAndKeep();
+        return block;
+    }
+
+    Parser::OpenStatement Parser::OpenConditionalStatement()
+    {
+        // TODO: For else and else if statements you can use an if statement stack to determine which if
+        // statement do they belong but for now I am not going to support else and else if statements.
+        const auto    kind = (m_CurrentToken.type == TokenType::KeywordIf) ? StatementKind::IfStatement
+                                                                           : StatementKind::WhileStatement;
+        OpenStatement cond{ .stmt = Statement{ .kind = kind }, .mark = Mark() };
+
+        // Consume the if or while keyword.
+        ConsumeAndKeep();
+
+        // Save the token.
+        auto pre_cond_token = m_CurrentToken;
+
+        // Our condition statement.
+        auto condition = ExpectExpression();
+        if (condition)
+        {
+            // Check if the expression type is a boolean.
+            if (m_Tree[*condition].type == TypeTable::Boolean)
+            {
+                // Append our condition statement, the body follows.
+                m_PendingChildren.push_back(*condition);
+                cond.body_token = m_CurrentToken;
+            }
+            else
+            {
+                CompileError(pre_cond_token, "Type mismatch. Cannot perform implicit conversion from '{}' to '{}'.",
+                             TypeOf(m_Tree[*condition].type).ToString(), TypeOf(TypeTable::Boolean).ToString());
+            }
+        }
+        else
         {
-            result = ExpectKeyword();
-            if (result)
-                return result;
+            CompileError(pre_cond_token, "Expected an expression evaluating to bool.");
         }
+        return cond;
+    }
+
+    std::optional<NodeId> Parser::ExpectSimpleStatement()
+    {
+        // Check for a keyword statement, those take care of their own semicolon.
+        auto result = ExpectKeyword();
+        if (result)
+            return result;
 
         // Else check for a variable declaration statement.
         if (!result)
@@ -322,199 +835,157 @@ namespace cmm::cmc {
             result = ExpectExpression();
 
         // Check for the semicolon.
-        if (m_CurrentToken->type == TokenType::SemiColon)
+        if (m_CurrentToken.type == TokenType::SemiColon)
         {
             // Consume the semicolon.
             Consume();
 
             // If we don't have a result then it is a no-op statement.
             if (!result)
-                return Statement{ .kind = StatementKind::NoOperationStatement };
+                return Finish(Mark(), Statement{ .kind = StatementKind::NoOperationStatement });
         }
         else
         {
-            CompileError(*m_CurrentToken, "Expected a semicolon but got {} instead.", m_CurrentToken->ToString());
+            CompileError(m_CurrentToken, "Expected a semicolon but got {} instead.", m_CurrentToken.ToString());
         }
 
         return result;
     }
 
-    std::optional<ast::Statement> Parser::ExpectBlockStatement()
+    std::optional<NodeId> Parser::ExpectVariableDeclaration()
     {
-        // Check for a start of a block statement.
-        if (m_CurrentToken->type == TokenType::LeftCurlyBrace)
+        if (m_CurrentToken.IsValid() && m_CurrentToken.type == TokenType::KeywordLet)
         {
-            // Create a new symbol table for our compound statement and push it onto the stack.
-            m_SymbolTableStack.push_back(SymbolTable{});
-
-            // Consume the left curly brace.
-            auto brace_token = *Consume();
-
-            // Our block statement.
-            Statement block_stmt;
-            block_stmt.kind = StatementKind::BlockStatement;
-            block_stmt.tokens.push_back(std::move(brace_token));
-
-            // Iterate through the tokens until we hit a closing curly brace.
-            while (m_CurrentToken->type != TokenType::RightCurlyBrace)
-            {
-                // If we meet a EOF instead of a closing curly brace.
-                if (!m_CurrentToken->IsValid())
-                {
-                    CompileError(*m_CurrentToken, "Expected a closing curly brace to end the block statement.");
-                }
-                else
-                {
-                    // Recursevly parse statements and append them to our block statement (if any).
-                    auto stmt = ExpectLocalStatement();
-                    if (stmt)
-                        block_stmt.children.push_back(std::move(*stmt));
-                }
-            }
-
-            // Consume the closing curly brace.
-            brace_token = *Consume();
-            block_stmt.tokens.push_back(std::move(brace_token));
-
-            // Pop our compound statement's symbol table out and finally return our compound statement.
-            m_SymbolTableStack.pop_back();
-            return block_stmt;
-        }
-        return std::nullopt;
-    }
+            // Our variable declaration statement.
+            Statement  var_decl{};
+            const auto mark = Mark();
+            var_decl.kind   = StatementKind::VariableDeclaration;
 
-    std::optional<ast::Statement> Parser::ExpectVariableDeclaration()
-    {
-        if (m_CurrentToken->IsValid() && m_CurrentToken.value().type == TokenType::KeywordLet)
-        {
             // Consume our let token.
-            Token let_token = *Consume();
+            Token let_token = ConsumeAndKeep();
             Token ident_token{};
 
-            // Our variable declaration statement.
-            Statement var_decl{};
-            var_decl.kind = StatementKind::VariableDeclaration;
-            var_decl.tokens.push_back(std::move(let_token));
-
             // The following token must be valid and an identifier.
-            if (m_CurrentToken->IsValid() && m_CurrentToken.value().type == TokenType::Identifier)
+            if (m_CurrentToken.IsValid() && m_CurrentToken.type == TokenType::Identifier)
             {
-                ident_token   = *Consume();
-                var_decl.name = ident_token.span.text;
-                var_decl.tokens.push_back(ident_token);
+                ident_token   = ConsumeAndKeep();
+                var_decl.name = ident_token.GetSymbolId();
             }
             else
             {
-                CompileError(*m_CurrentToken, "Expected an identifier after the let keyword.");
+                CompileError(m_CurrentToken, "Expected an identifier after the let keyword.");
             }
 
             // The token following the identifier must be a colon type specifier.
-            if (auto token = Consume(); !token->IsValid() || token.value().type != TokenType::Colon)
+            if (auto token = Consume(); !token.IsValid() || token.type != TokenType::Colon)
             {
-                CompileError(*m_CurrentToken, "Expected a colon type specifier.");
+                CompileError(m_CurrentToken, "Expected a colon type specifier.");
             }
 
             // The following token now must be a type.
-            if (m_CurrentToken->IsValid())
+            if (m_CurrentToken.IsValid())
             {
                 // Consume our type token then try and create type from it.
-                auto type_token = *Consume();
-                auto type_opt   = Type::FromToken(type_token);
+                auto type_token = Consume();
+                auto type_opt   = TypeTable::Global().FromToken(type_token);
 
                 if (type_opt)
                 {
                     // Check if it is a possible array.
-                    if (m_CurrentToken->type == TokenType::LeftSquareBracket)
+                    if (m_CurrentToken.type == TokenType::LeftSquareBracket)
                     {
                         // Consume the opening square bracket.
                         Consume();
 
                         // The following token must be a length specifier in the form of a number literal.
-                        if (m_CurrentToken->type == TokenType::NumberLiteral)
-                            type_opt->length = Consume().value().num;
+                        if (m_CurrentToken.type == TokenType::NumberLiteral)
+                            type_opt = TypeTable::Global().ArrayOf(*type_opt, Consume().num);
                         else
                         {
-                            CompileError(*m_CurrentToken,
+                            CompileError(m_CurrentToken,
                                          "Expected an array length specifier in the form of an integer literal.");
                         }
 
                         // The following token must be a closing square bracket.
-                        if (auto rsq_bracket = *Consume(); rsq_bracket.type != TokenType::RightSquareBracket)
+                        if (auto rsq_bracket = Consume(); rsq_bracket.type != TokenType::RightSquareBracket)
                         {
                             CompileError(rsq_bracket, "Expected a closing square bracket.");
                         }
                     }
-                    var_decl.type = std::move(*type_opt);
+                    var_decl.type = *type_opt;
                 }
                 else
                 {
-                    CompileError(*m_CurrentToken, "Unknown type {}.", type_token.span.text);
+                    CompileError(m_CurrentToken, "Unknown type {}.", type_token.span.text);
                 }
             }
             else
             {
-                CompileError(*m_CurrentToken, "Expected a type.");
+                CompileError(m_CurrentToken, "Expected a type.");
             }
 
             // Now we either have a semicolon or initializer.
-            if (m_CurrentToken->IsValid())
+            if (m_CurrentToken.IsValid())
             {
                 // It is an initializer.
-                if (m_CurrentToken->type == TokenType::Equals)
+                if (m_CurrentToken.type == TokenType::Equals)
                 {
-                    // Consume the equals.
-                    auto equals_token = *Consume();
-
                     // Our initializer statement.
-                    Statement init_stmt{};
-                    init_stmt.tokens.push_back(std::move(equals_token));
-                    init_stmt.kind = StatementKind::Initializer;
+                    Statement  init_stmt{};
+                    const auto init_mark = Mark();
+                    init_stmt.kind       = StatementKind::Initializer;
+
+                    // Consume the equals.
+                    auto equals_token = ConsumeAndKeep();
 
                     // Save the token before expression parsing.
-                    auto pre_expr_token = *m_CurrentToken;
+                    auto pre_expr_token = m_CurrentToken;
 
                     // The initializer expression.
                     auto init_expr = ExpectExpression();
                     if (init_expr)
                     {
+                        const auto& init     = m_Tree[*init_expr];
+                        const auto& var_type = TypeOf(var_decl.type);
+
                         // Check if our variable is an array.
-                        if (var_decl.type.IsArray())
+                        if (var_type.IsArray())
                         {
                             // If the lengths mismatch then it's an error.
-                            if (init_expr->children.size() != var_decl.type.length)
+                            if (init.child_count != var_type.length)
                             {
-                                CompileError(init_expr->tokens[0],
+                                CompileError(GetStatementToken(*init_expr, 0),
                                              "'{}' is an array of {} elements but is initialized with an initializer "
                                              "list of length {}.",
-                                             var_decl.name, var_decl.type.length, init_expr->children.size());
+                                             NameOf(var_decl.name), var_type.length, init.child_count);
                             }
 
                             // Check if there's a type mismatch.
-                            for (const auto& e : init_expr->children)
+                            for (const auto e : m_Tree.GetChildren(*init_expr))
                             {
                                 // Compare the ELEMENT types.
-                                if (e.type.ftype != var_decl.type.ftype)
+                                if (TypeOf(m_Tree[e].type).ftype != var_type.ftype)
                                 {
                                     CompileError(
-                                        e.tokens.at(0),
+                                        GetStatementToken(e, 0),
                                         "Type mistmatch. Cannot perform implicit conversion from '{}' to '{}'.",
-                                        e.type.ToString(), var_decl.type.ToString());
+                                        TypeOf(m_Tree[e].type).ToString(), var_type.ToString());
                                 }
                             }
                         }
                         else
                         {
                             // Check if there's a type mismatch between the initializer expression and the variable.
-                            if (init_expr->type != var_decl.type)
+                            if (init.type != var_decl.type)
                             {
-                                CompileError(init_stmt.tokens[0],
+                                CompileError(equals_token,
                                              "Type mismatch. Cannot perform implicit conversion from '{}' to '{}'.",
-                                             init_expr->type.ToString(), var_decl.type.ToString());
+                                             TypeOf(init.type).ToString(), var_type.ToString());
                             }
                         }
 
                         // If we reached here then everything is fine so just append our initializer and move on.
-                        init_stmt.children.push_back(std::move(*init_expr));
+                        m_PendingChildren.push_back(*init_expr);
                     }
                     else
                     {
@@ -522,164 +993,62 @@ namespace cmm::cmc {
                     }
 
                     // Append our initializer statement.
-                    var_decl.children.push_back(std::move(init_stmt));
+                    m_PendingChildren.push_back(Finish(init_mark, std::move(init_stmt)));
                 }
 
-                // Check if the variable already exists in our block's symbol table.
-                if (m_SymbolTableStack.back().ContainsSymbol(var_decl.name))
+                // Check if the variable already exists in our block's scope.
+                if (const auto prev = m_Symbols.FindInScope(var_decl.name); prev != m_Symbols.NoHandle)
                 {
-                    auto& sym          = m_SymbolTableStack.back().GetSymbol(var_decl.name);
-                    auto& redecl_token = sym.statement.tokens[0];
-                    CompileError(var_decl.tokens[0],
+                    auto redecl_loc = Locate(GetStatementToken(m_Symbols.Get(prev), 0));
+                    CompileError(let_token,
                                  "Redeclaration of an already existing name '{}' in the same context previously "
                                  "defined @ line ({}, {}).",
-                                 var_decl.name, redecl_token.span.line, redecl_token.span.cur);
+                                 NameOf(var_decl.name), redecl_loc.line, redecl_loc.column);
                 }
-                else
-                {
-                    // Append our new variable to our symbol table and return it.
-                    m_SymbolTableStack.back().AddSymbol(Symbol{ .name = ident_token.span.text, .statement = var_decl });
-                }
-                return var_decl;
+
+                // Append our new variable to our symbol table and return it.
+                const auto name = var_decl.name;
+                const auto id   = Finish(mark, std::move(var_decl));
+                m_Symbols.Declare(name, id);
+                return id;
             }
         }
         return std::nullopt;
     }
 
-    std::optional<ast::Statement> Parser::ExpectKeyword()
+    std::optional<NodeId> Parser::ExpectKeyword()
     {
         // If our token is valid and an actual keyword (obviously).
-        if (m_CurrentToken->IsValid() && m_CurrentToken.value().IsKeyword())
+        if (m_CurrentToken.IsValid() && m_CurrentToken.IsKeyword())
         {
-            switch (m_CurrentToken->type)
+            switch (m_CurrentToken.type)
             {
                 using enum TokenType;
 
-                // TODO: For else and else if statements you can use an if statement stack to determine which if
-                // statement do they belong but for now I am not going to support else and else if statements.
-                case KeywordIf: {
-                    // Consume the if keyword.
-                    auto if_keyword = *Consume();
-
-                    // Our If statement.
-                    Statement if_stmt{};
-                    if_stmt.kind = StatementKind::IfStatement;
-                    if_stmt.tokens.push_back(std::move(if_keyword));
-
-                    // Save the token.
-                    auto pre_cond_token = *m_CurrentToken;
-
-                    // Else it's just a regular if statement.
-                    auto condition = ExpectExpression();
-                    if (condition)
-                    {
-                        // Check if the expression type is a boolean.
-                        if (condition->type == Type::Boolean)
-                        {
-                            // Append our condition statement.
-                            if_stmt.children.push_back(std::move(*condition));
-
-                            // Save the token.
-                            auto pre_body_token = *m_CurrentToken;
-
-                            // The body for the if statement.
-                            auto body_stmt = ExpectLocalStatement();
-                            if (body_stmt)
-                                if_stmt.children.push_back(std::move(*body_stmt));
-                            else
-                            {
-                                CompileError(pre_body_token, "Expected a body for the if statement.");
-                            }
-
-                            // Finally return our if statement.
-                            return if_stmt;
-                        }
-                        else
-                        {
-                            CompileError(pre_cond_token,
-                                         "Type mismatch. Cannot perform implicit conversion from '{}' to '{}'.",
-                                         condition->type.ToString(), Type::Boolean.ToString());
-                        }
-                    }
-                    else
-                    {
-                        CompileError(pre_cond_token, "Expected an expression evaluating to bool.");
-                    }
-                    break;
-                }
-                case KeywordWhile: {
-                    // Consume the while keyword.
-                    auto while_keyword = *Consume();
-
-                    // Our If statement.
-                    Statement while_stmt{};
-                    while_stmt.kind = StatementKind::WhileStatement;
-                    while_stmt.tokens.push_back(std::move(while_keyword));
-
-                    // Save the token.
-                    auto pre_cond_token = *m_CurrentToken;
-
-                    // Our while's condition statement.
-                    auto condition = ExpectExpression();
-                    if (condition)
-                    {
-                        // Check if the expression type is a boolean.
-                        if (condition->type == Type::Boolean)
-                        {
-                            // Append our condition statement.
-                            while_stmt.children.push_back(std::move(*condition));
-
-                            // Save the token.
-                            auto pre_body_token = *m_CurrentToken;
-
-                            // The body for the if statement.
-                            auto body_stmt = ExpectLocalStatement();
-                            if (body_stmt)
-                                while_stmt.children.push_back(std::move(*body_stmt));
-                            else
-                            {
-                                CompileError(pre_body_token, "Expected a body for the while statement.");
-                            }
-
-                            // Finally return our while statement.
-                            return while_stmt;
-                        }
-                        else
-                        {
-                            CompileError(pre_cond_token,
-                                         "Type mismatch. Cannot perform implicit conversion from '{}' to '{}'.",
-                                         condition->type.ToString(), Type::Boolean.ToString());
-                        }
-                    }
-                    else
-                    {
-                        CompileError(pre_cond_token, "Expected an expression evaluating to bool.");
-                    }
-                    break;
-                }
                 case KeywordReturn: {
                     // Consume the return token.
                     Consume();
 
                     // The return statement.
-                    Statement stmt{};
-                    stmt.kind = StatementKind::ReturnStatement;
+                    Statement  stmt{};
+                    const auto mark = Mark();
+                    stmt.kind       = StatementKind::ReturnStatement;
 
                     // If an expression follows our return statement.
                     auto exp = ExpectExpression();
                     if (exp)
-                        stmt.children.push_back(std::move(*exp));
+                        m_PendingChildren.push_back(*exp);
 
                     // Check for the semicolon of course.
-                    if (m_CurrentToken->IsValid() && m_CurrentToken.value().type == TokenType::SemiColon)
+                    if (m_CurrentToken.IsValid() && m_CurrentToken.type == TokenType::SemiColon)
                     {
                         // Consume the semicolon.
                         Consume();
-                        return stmt;
+                        return Finish(mark, std::move(stmt));
                     }
                     else
                     {
-                        CompileError(*m_CurrentToken, "Expected a semicolon after the return statement.");
+                        CompileError(m_CurrentToken, "Expected a semicolon after the return statement.");
                     }
                     break;
                 }
@@ -689,12 +1058,23 @@ namespace cmm::cmc {
         return std::nullopt;
     }
 
-    std::optional<Statement> Parser::ExpectExpression()
+    std::optional<NodeId> Parser::ExpectExpression()
+    {
+        EnterExpression();
+        auto result = ExpectBinaryExpression(0);
+        --m_ExpressionDepth;
+        return result;
+    }
+
+    void Parser::EnterExpression()
     {
-        return ExpectCondition();
+        if (++m_ExpressionDepth > m_MaxExpressionDepth)
+        {
+            CompileError(m_CurrentToken, "Expression nested too deeply, the limit is {} levels.", m_MaxExpressionDepth);
+        }
     }
 
-    std::optional<Statement> Parser::ExpectPrimaryExpression()
+    std::optional<NodeId> Parser::ExpectPrimaryExpression()
     {
         // Check if it's a function call expression.
         auto result = ExpectAssignment();
@@ -724,105 +1104,79 @@ namespace cmm::cmc {
         return std::nullopt;
     }
 
-    std::optional<Statement> Parser::ExpectLiteral()
+    std::optional<NodeId> Parser::ExpectLiteral()
     {
         // If our token is valid.
-        if (m_CurrentToken->IsValid())
+        if (m_CurrentToken.IsValid())
         {
             // Check for the type of the literal.
-            switch (m_CurrentToken->type)
+            Statement stmt{ .kind = StatementKind::LiteralExpression };
+            switch (m_CurrentToken.type)
             {
                 using enum TokenType;
 
-                case NumberLiteral: {
-                    auto      token = *Consume();
-                    Statement stmt{};
-                    stmt.kind = StatementKind::LiteralExpression;
-                    stmt.type = Type::Integer64;
-                    stmt.tokens.push_back(std::move(token));
-                    return stmt;
-                }
-                case StringLiteral: {
-                    auto      token = *Consume();
-                    Statement stmt{};
-                    stmt.kind = StatementKind::LiteralExpression;
-                    stmt.type = Type::String(token);
-                    stmt.tokens.push_back(std::move(token));
-                    return stmt;
-                }
-                case CharacterLiteral: {
-                    auto      token = *Consume();
-                    Statement stmt{};
-                    stmt.kind = StatementKind::LiteralExpression;
-                    stmt.type = Type::Character;
-                    stmt.tokens.push_back(std::move(token));
-                    return stmt;
-                }
+                case NumberLiteral: stmt.type = TypeTable::Integer64; break;
+                case StringLiteral: stmt.type = TypeTable::String; break;
+                case CharacterLiteral: stmt.type = TypeTable::Character; break;
                 case KeywordTrue:
-                case KeywordFalse: {
-                    auto      token = *Consume();
-                    Statement stmt{};
-                    stmt.kind = StatementKind::LiteralExpression;
-                    stmt.type = Type::Boolean;
-                    stmt.tokens.push_back(std::move(token));
-                    return stmt;
-                }
-                default: break;
+                case KeywordFalse: stmt.type = TypeTable::Boolean; break;
+                default: return std::nullopt;
             }
+
+            const auto mark = Mark();
+            ConsumeAndKeep();
+            return Finish(mark, std::move(stmt));
         }
         return std::nullopt;
     }
 
-    std::optional<Statement> Parser::ExpectIdentifierName()
+    std::optional<NodeId> Parser::ExpectIdentifierName()
     {
         // If the current token is infact an identifier.
-        if (m_CurrentToken->IsValid() && m_CurrentToken.value().type == TokenType::Identifier)
+        if (m_CurrentToken.IsValid() && m_CurrentToken.type == TokenType::Identifier)
         {
             // Consume the identifier token.
-            auto ident_token = *Consume();
+            auto ident_token = Consume();
 
             // Create our identifier statement.
             Statement name_stmt{};
             name_stmt.kind = StatementKind::IdentifierName;
-            name_stmt.name = ident_token.span.text;
+            name_stmt.name = ident_token.GetSymbolId();
 
-            // Perform a symbol table lookup.
-            for (auto it = m_SymbolTableStack.rbegin(); it != m_SymbolTableStack.rend(); ++it)
-            {
-                const auto& e = *it;
-                if (e.ContainsSymbol(name_stmt.name))
-                    name_stmt.type = e.GetSymbol(name_stmt.name).statement.type;
-            }
+            // Perform a symbol table lookup, the innermost declaration wins.
+            if (const auto decl = m_Symbols.Find(name_stmt.name); decl != m_Symbols.NoHandle)
+                name_stmt.type = m_Tree[m_Symbols.Get(decl)].type;
 
             // If the type is still void then the lookup most likely failed.
-            if (name_stmt.type.IsVoid())
+            if (name_stmt.type == TypeTable::Void)
             {
-                CompileError(ident_token, "The name '{}' does not exist in the current context.", name_stmt.name);
+                CompileError(ident_token, "The name '{}' does not exist in the current context.",
+                             ident_token.span.text);
             }
             else
             {
                 // Else everything is fine so return our identifier name reference statement.
-                return name_stmt;
+                return Finish(Mark(), std::move(name_stmt));
             }
         }
         return std::nullopt;
     }
 
-    std::optional<Statement> Parser::ExpectInitializerList()
+    std::optional<NodeId> Parser::ExpectInitializerList()
     {
         // Check if the token is infact an opening curly brace.
-        if (m_CurrentToken->type == TokenType::LeftCurlyBrace)
+        if (m_CurrentToken.type == TokenType::LeftCurlyBrace)
         {
-            // Consume the opening curly brace.
-            auto left_curly = *Consume();
-
             // Our initializer list statement.
-            Statement init_list{};
-            init_list.kind = StatementKind::InitializerList;
-            init_list.tokens.push_back(std::move(left_curly));
+            Statement  init_list{};
+            const auto mark = Mark();
+            init_list.kind  = StatementKind::InitializerList;
+
+            // Consume the opening curly brace.
+            ConsumeAndKeep();
 
             // Parse the tokens until we hit a closing curly brace.
-            while (m_CurrentToken->type != TokenType::RightCurlyBrace)
+            while (m_CurrentToken.type != TokenType::RightCurlyBrace)
             {
                 // Parse the expression element.
                 auto expr = ExpectExpression();
@@ -830,114 +1184,112 @@ namespace cmm::cmc {
                 {
                     // Either a comma must follow our parsed expression or the initializer list should end, otherwise
                     // it's a compile error.
-                    if (m_CurrentToken->type == TokenType::Comma)
+                    if (m_CurrentToken.type == TokenType::Comma)
                         // Consume the comma and move on.
                         Consume();
-                    else if (m_CurrentToken->type != TokenType::RightCurlyBrace)
+                    else if (m_CurrentToken.type != TokenType::RightCurlyBrace)
                     {
-                        CompileError(*m_CurrentToken, "Expected a closing curly brace.");
+                        CompileError(m_CurrentToken, "Expected a closing curly brace.");
                     }
-                    init_list.children.push_back(std::move(*expr));
+                    m_PendingChildren.push_back(*expr);
                 }
                 else
                 {
-                    CompileError(*m_CurrentToken, "Invalid expression inside of an initializer list.");
+                    CompileError(m_CurrentToken, "Invalid expression inside of an initializer list.");
                 }
             }
 
             // Check if our initializer list was properly established.
-            if (auto closing_curly = *Consume(); closing_curly.IsValid())
+            if (m_CurrentToken.IsValid())
             {
                 // Consume and append our closing curly brace to the initializer list statement.
-                init_list.tokens.push_back(closing_curly);
-                init_list.type        = init_list.children.back().type;
-                init_list.type.length = init_list.children.size();
-                return init_list;
+                ConsumeAndKeep();
+                init_list.type = TypeTable::Global().ArrayOf(m_Tree[m_PendingChildren.back()].type,
+                                                             m_PendingChildren.size() - mark.children);
+                return Finish(mark, std::move(init_list));
             }
             else
             {
-                CompileError(*m_CurrentToken, "Expected a closing curly brace.");
+                CompileError(m_CurrentToken, "Expected a closing curly brace.");
             }
         }
         return std::nullopt;
     }
 
-    std::optional<ast::Statement> Parser::ExpectFunctionCall()
+    std::optional<NodeId> Parser::ExpectFunctionCall()
     {
         // Check for the identifier.
-        if (m_CurrentToken->type == TokenType::Identifier)
+        if (m_CurrentToken.type == TokenType::Identifier)
         {
             // Check if the following token (without consuming casue we are unsure) is an opening brace.
-            if (Peek()->type == TokenType::LeftBrace)
+            if (Peek().type == TokenType::LeftBrace)
             {
+                // Our function call statement.
+                Statement  func_call{};
+                const auto mark = Mark();
+
                 // Now we definitely know that it's a function call.
-                auto ident_token = *Consume();
+                auto ident_token = ConsumeAndKeep();
 
-                // Try and find the function.
-                Statement ref_fn{};
-                for (const auto& fn : m_GlobalStatements)
-                {
-                    if (fn.kind == StatementKind::FunctionDeclaration)
-                    {
-                        if (fn.name == ident_token.span.text)
-                            ref_fn = fn;
-                    }
-                }
+                // Try and find the function, the last one declared before us with the name wins.
+                const auto ref_fn = m_Functions.Find(ident_token.GetSymbolId());
 
                 // If the function was not found.
-                if (ref_fn.kind == StatementKind::None)
+                if (ref_fn == m_Functions.NoHandle)
                 {
                     CompileError(ident_token, "The name '{}' does not exist in the current context.",
                                  ident_token.span.text);
                 }
 
-                // Our function call statement.
-                Statement func_call{};
-                func_call.name = ident_token.span.text;
-                func_call.kind = StatementKind::FunctionCallExpression;
-                func_call.type = ref_fn.type;
-                func_call.tokens.push_back(std::move(ident_token));
+                const auto& signature = m_Functions.Get(ref_fn);
+                func_call.name        = ident_token.GetSymbolId();
+                func_call.kind        = StatementKind::FunctionCallExpression;
+                func_call.type        = signature.type;
 
                 auto arg_list = ExpectFunctionArgumentList();
 
                 // Check for a type mismatch.
-                for (usize i = 0; i < arg_list.children.size(); ++i)
+                for (usize i = 0; i < m_Tree[arg_list].child_count; ++i)
                 {
-                    if (arg_list.children[i].type != ref_fn.children[0].children[i].type)
+                    const auto arg_type   = m_Tree[m_Tree.GetChild(arg_list, i)].type;
+                    const auto param_type = (i < signature.parameters.size()) ? signature.parameters[i]
+                                                                              : TypeTable::Void;
+                    if (arg_type != param_type)
                     {
                         CompileError(ident_token,
                                      "Cannot perform implicit conversion from '{}' to '{}'. No matching function "
                                      "call to '{}'.",
-                                     arg_list.children[i].type.ToString(),
-                                     ref_fn.children[0].children[i].type.ToString(), func_call.name);
+                                     TypeOf(arg_type).ToString(), TypeOf(param_type).ToString(),
+                                     NameOf(func_call.name));
                     }
                 }
 
                 // Finally, return our function call statement.
-                func_call.children.push_back(std::move(arg_list));
-                return func_call;
+                m_PendingChildren.push_back(arg_list);
+                return Finish(mark, std::move(func_call));
             }
         }
         return std::nullopt;
     }
 
-    ast::Statement Parser::ExpectFunctionArgumentList()
+    NodeId Parser::ExpectFunctionArgumentList()
     {
-        Statement args{};
-        if (m_CurrentToken->type == TokenType::LeftBrace)
+        Statement  args{};
+        const auto mark = Mark();
+        if (m_CurrentToken.type == TokenType::LeftBrace)
         {
             // Consume the left brace.
-            auto prev_token = *Consume();
+            auto prev_token = Consume();
 
             // If our token is not eof.
-            while (m_CurrentToken->IsValid())
+            while (m_CurrentToken.IsValid())
             {
-                if (m_CurrentToken->type == TokenType::Comma)
+                if (m_CurrentToken.type == TokenType::Comma)
                 {
                     // There are more parameters so just progress forward.
                     Consume();
                 }
-                else if (m_CurrentToken->type == TokenType::RightBrace)
+                else if (m_CurrentToken.type == TokenType::RightBrace)
                 {
                     // We've reached the end so terminate.
                     break;
@@ -947,18 +1299,18 @@ namespace cmm::cmc {
                     auto expr = ExpectExpression();
                     if (expr)
                     {
-                        args.children.push_back(std::move(*expr));
+                        m_PendingChildren.push_back(*expr);
                     }
                     else
                     {
-                        CompileError(*m_CurrentToken, "Expected a function argument.");
+                        CompileError(m_CurrentToken, "Expected a function argument.");
                     }
                 }
             }
 
-            if (!m_CurrentToken->IsValid())
+            if (!m_CurrentToken.IsValid())
             {
-                CompileError(*m_CurrentToken, "Expected a closing brace after the function argument list.");
+                CompileError(m_CurrentToken, "Expected a closing brace after the function argument list.");
             }
             else
             {
@@ -969,42 +1321,44 @@ namespace cmm::cmc {
         }
         else
         {
-            CompileError(*m_CurrentToken, "Expected an argument list.");
+            CompileError(m_CurrentToken, "Expected an argument list.");
         }
-        return args;
+        return Finish(mark, std::move(args));
     }
 
-    std::optional<ast::Statement> Parser::ExpectAssignment()
+    std::optional<NodeId> Parser::ExpectAssignment()
     {
-        if (m_CurrentToken->type == TokenType::Identifier)
+        if (m_CurrentToken.type == TokenType::Identifier)
         {
-            if (Peek()->type == TokenType::Equals)
+            if (Peek().type == TokenType::Equals)
             {
                 // Parse our identifier.
                 auto lhv = *ExpectIdentifierName();
 
                 // Consuem the equals token.
-                auto equals_token = *Consume();
+                auto equals_token = Consume();
 
-                auto pre_rhv_token = *m_CurrentToken;
+                auto pre_rhv_token = m_CurrentToken;
 
                 auto rhv = ExpectExpression();
                 if (rhv)
                 {
-                    if (rhv->type == lhv.type)
+                    if (m_Tree[*rhv].type == m_Tree[lhv].type)
                     {
                         Statement assign_expr{};
-                        assign_expr.type = lhv.type;
+                        assign_expr.type = m_Tree[lhv].type;
                         assign_expr.kind = StatementKind::AssignmentExpression;
-                        assign_expr.children.push_back(std::move(lhv));
-                        assign_expr.children.push_back(std::move(*rhv));
-                        return assign_expr;
+
+                        const auto mark = Mark();
+                        m_PendingChildren.push_back(lhv);
+                        m_PendingChildren.push_back(*rhv);
+                        return Finish(mark, std::move(assign_expr));
                     }
                     else
                     {
                         CompileError(pre_rhv_token,
                                      "Type mismatch. Cannot perform implicit conversion from '{}' to '{}'.",
-                                     rhv->type.ToString(), lhv.type.ToString());
+                                     TypeOf(m_Tree[*rhv].type).ToString(), TypeOf(m_Tree[lhv].type).ToString());
                     }
                 }
                 else
@@ -1016,169 +1370,87 @@ namespace cmm::cmc {
         return std::nullopt;
     }
 
-    std::optional<ast::Statement> Parser::ExpectAddition()
+    NodeId Parser::MakeBinary(const StatementKind kind, const TypeId type, const u32 op_token, const NodeId lhs,
+                              const NodeId rhs)
     {
-        auto result = ExpectMultiplication();
-        while (m_CurrentToken->type == TokenType::Plus || m_CurrentToken->type == TokenType::Minus)
-        {
-            auto op_token = *Consume();
-            auto rhv_expr = ExpectMultiplication();
-
-            // Our multiplication expression.
-            Statement binary_expr{};
-
-            if (result)
-            {
-                binary_expr.kind = (op_token.type == TokenType::Plus) ? StatementKind::AdditionExpression
-                                                                      : StatementKind::SubtractionExpression;
-                switch (result->type.ftype)
-                {
-                    // We support fundamental types for now.
-                    using enum FundamentalType;
+        const auto mark = Mark();
+        m_PendingTokens.push_back(op_token);
+        m_PendingChildren.push_back(lhs);
+        m_PendingChildren.push_back(rhs);
+        return Finish(mark, Statement{ .kind = kind, .type = type });
+    }
 
-                    case Integer32:
-                    case Integer64: {
-                        if (result->type == rhv_expr->type)
-                        {
-                            binary_expr.type = result->type;
-                            binary_expr.tokens.push_back(std::move(op_token));
-                            binary_expr.children.push_back(std::move(*result));
-                            binary_expr.children.push_back(std::move(*rhv_expr));
-                            result = std::move(binary_expr);
-                        }
-                        else
-                        {
-                            CompileError(*m_CurrentToken,
-                                         "Type mismatch. Cannot perform implicit conversion from '{}' to '{}'.",
-                                         result->type.ToString(), rhv_expr->type.ToString());
-                        }
-                        break;
-                    }
-                    default: {
-                        CompileError(op_token, "Cannot perform '{}' on type {}.", op_token.span.text,
-                                     result->type.ToString());
-                        break;
-                    }
-                }
-            }
-            else
+    std::optional<NodeId> Parser::ExpectBinaryExpression(const u8 min_power)
+    {
+        auto result = ExpectUnaryExpression();
+        while (true)
+        {
+            // Stop at anything that isn't a binary operator or one that binds looser than whatever we are the right
+            // hand side of, it then becomes the parent of the expression we built so far.
+            const auto& op = BinaryOperators[(usize)m_CurrentToken.type];
+            if (op.power <= min_power)
+                break;
+
+            const auto op_index = (u32)m_TokenIndex;
+            auto       op_token = Consume();
+            if (!result)
             {
                 CompileError(op_token, "Expected an expression on the left hand side of the '{}' operator",
                              op_token.span.text);
             }
-        }
-        return result;
-    }
-
-    std::optional<ast::Statement> Parser::ExpectMultiplication()
-    {
-        auto result = ExpectPrimaryExpression();
-        while (m_CurrentToken->type == TokenType::Asterisk || m_CurrentToken->type == TokenType::ForwardSlash)
-        {
-            auto op_token = *Consume();
-            auto rhv_expr = ExpectPrimaryExpression();
-
-            // Our multiplication expression.
-            Statement binary_expr{};
 
-            if (result)
+            auto rhv_expr = ExpectBinaryExpression(op.power);
+            if (!rhv_expr)
             {
-                binary_expr.kind = (op_token.type == TokenType::Asterisk) ? StatementKind::MultiplicationExpression
-                                                                          : StatementKind::DivisionExpression;
-                switch (result->type.ftype)
-                {
-                    // We support fundamental types for now.
-                    using enum FundamentalType;
-
-                    case Integer32:
-                    case Integer64: {
-                        if (result->type == rhv_expr->type)
-                        {
-                            binary_expr.type = result->type;
-                            binary_expr.tokens.push_back(std::move(op_token));
-                            binary_expr.children.push_back(std::move(*result));
-                            binary_expr.children.push_back(std::move(*rhv_expr));
-                            result = std::move(binary_expr);
-                        }
-                        else
-                        {
-                            CompileError(*m_CurrentToken,
-                                         "Type mismatch. Cannot perform implicit conversion from '{}' to '{}'.",
-                                         result->type.ToString(), rhv_expr->type.ToString());
-                        }
+                CompileError(op_token, "Expected an expression on the right hand side of the '{}' operator",
+                             op_token.span.text);
+            }
 
-                        break;
-                    }
-                    default: {
-                        CompileError(op_token, "Cannot perform '{}' on type {}.", op_token.span.text,
-                                     result->type.ToString());
-                        break;
-                    }
-                }
+            const auto lhv_type = m_Tree[*result].type;
+            const auto rhv_type = m_Tree[*rhv_expr].type;
+            if (!SatisfiesRule(op.operands, lhv_type))
+            {
+                CompileError(op_token, "Cannot perform '{}' on type {}.", op_token.span.text,
+                             TypeOf(lhv_type).ToString());
             }
-            else
+            if (lhv_type != rhv_type)
             {
-                CompileError(op_token, "Expected an expression on the left hand side of the '{}' operator",
-                             op_token.span.text);
+                CompileError(m_CurrentToken, "Type mismatch. Cannot perform implicit conversion from '{}' to '{}'.",
+                             TypeOf(lhv_type).ToString(), TypeOf(rhv_type).ToString());
             }
+
+            // Arithmetic keeps the type of its operands, everything else evaluates to bool.
+            const auto type = (op.operands == OperandRule::Integer) ? lhv_type : TypeTable::Boolean;
+            result          = MakeBinary(op.kind, type, op_index, *result, *rhv_expr);
         }
         return result;
     }
 
-    std::optional<ast::Statement> Parser::ExpectCondition()
+    std::optional<NodeId> Parser::ExpectUnaryExpression()
     {
-        auto result = ExpectAddition();
-
-        while (m_CurrentToken->type == TokenType::RightAngleBracket ||
-               m_CurrentToken->type == TokenType::LeftAngleBracket || m_CurrentToken->type == TokenType::EqualsEquals ||
-               m_CurrentToken->type == TokenType::GreaterThanEquals ||
-               m_CurrentToken->type == TokenType::LesserThanEquals ||
-               m_CurrentToken->type == TokenType::ExclamationEquals)
+        const auto& op = PrefixOperators[(usize)m_CurrentToken.type];
+        if (op.power == 0)
+            return ExpectPrimaryExpression();
+
+        // A chain of prefix operators nests just like parenthesized expressions would.
+        EnterExpression();
+        const auto mark     = Mark();
+        auto       op_token = ConsumeAndKeep();
+        auto       operand  = ExpectBinaryExpression(op.power);
+        --m_ExpressionDepth;
+        if (!operand)
         {
-            auto op_token = *Consume();
-            auto rhv_expr = ExpectAddition();
-
-            // Our multiplication expression.
-            Statement binary_expr{};
-
-            if (result)
-            {
-                switch (op_token.type)
-                {
-                    using enum TokenType;
-
-                    case RightAngleBracket: binary_expr.kind = StatementKind::GreaterExpression; break;
-                    case LeftAngleBracket: binary_expr.kind = StatementKind::LesserExpression; break;
-                    case EqualsEquals: binary_expr.kind = StatementKind::EqualsExpression; break;
-                    case GreaterThanEquals: binary_expr.kind = StatementKind::GreaterThanExpression; break;
-                    case LesserThanEquals: binary_expr.kind = StatementKind::LesserThanExpression; break;
-                    case ExclamationEquals: binary_expr.kind = StatementKind::NotEqualsExpression; break;
-                    default: break;
-                }
+            CompileError(op_token, "Expected an expression after the '{}' operator.", op_token.span.text);
+        }
 
-                // FIXME: This is buggy but whatever.
-                if (result->type == rhv_expr->type)
-                {
-                    binary_expr.type = Type::Boolean;
-                    binary_expr.tokens.push_back(std::move(op_token));
-                    binary_expr.children.push_back(std::move(*result));
-                    binary_expr.children.push_back(std::move(*rhv_expr));
-                    result = std::move(binary_expr);
-                }
-                else
-                {
-                    CompileError(*m_CurrentToken,
-                                 "Type mismatch. Cannot perform implicit conversion from '{}' to '{}'.",
-                                 result->type.ToString(), rhv_expr->type.ToString());
-                }
-            }
-            else
-            {
-                CompileError(op_token, "Expected an expression on the left hand side of the '{}' operator",
-                             op_token.span.text);
-            }
+        const auto type = m_Tree[*operand].type;
+        if (!SatisfiesRule(op.operands, type))
+        {
+            CompileError(op_token, "Cannot perform '{}' on type {}.", op_token.span.text, TypeOf(type).ToString());
         }
-        return result;
+
+        m_PendingChildren.push_back(*operand);
+        return Finish(mark, Statement{ .kind = op.kind, .type = type });
     }
 } // namespace cmm::cmc
 
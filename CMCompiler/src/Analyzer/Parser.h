@@ -2,25 +2,20 @@
 #define CMC_ANALYZER_PARSER_H
 
 #include <fmt/core.h>
+#include <memory>
 #include <nlohmann/json.hpp>
+#include <span>
 #include <stack>
+#include <stdexcept>
 #include <vector>
 
 #include "Lexer.h"
+#include "LineIndex.h"
+#include "SymbolTable.h"
+#include "TypeTable.h"
 
 namespace cmm::cmc {
     namespace ast {
-        enum class FundamentalType : u8
-        {
-            Void,
-            Integer32,
-            Integer64,
-            Boolean,
-            Character,
-            String,
-            UserDefined
-        };
-
         enum class StatementKind : u8
         {
             None,
@@ -52,6 +47,10 @@ namespace cmm::cmc {
             SubtractionExpression,
             MultiplicationExpression,
             DivisionExpression,
+            LogicalAndExpression,
+            LogicalOrExpression,
+            LogicalNotExpression,
+            NegationExpression,
 
             IfStatement,
             ElseIfStatement,
@@ -64,118 +63,231 @@ namespace cmm::cmc {
             LiteralExpression
         };
 
-        struct Type
+        // Statements live in a SyntaxTree and refer to each other by their index in it.
+        using NodeId = u32;
+
+        // Children and tokens are ranges of the tree's side arrays so a statement owns no memory of its own. A literal
+        // the ConstantFolder computed has no token, its first_token indexes its value in the tree's constants instead.
+        struct Statement
         {
         public:
-            std::string       name = "Void";
-            FundamentalType   ftype{};
-            std::vector<Type> fields{}; // For user defined types.
-            usize             length{}; // In element count (for arrays).
-            i8                size{};   // In bits.
+            SymbolId      name{};
+            StatementKind kind{};
+            u32           first_child{};
+            u32           child_count{};
+            u32           first_token{};
+            u32           token_count{};
+            TypeId        type{};
+        };
 
-        public:
-            static Type Integer32;
-            static Type Integer64;
-            static Type Character;
-            static Type Boolean;
+        // Every statement of a program in a single arena. The children of a statement are stored back to back in one
+        // side array and its tokens, as indices into the token stream the tree keeps alive, in another. The stream
+        // never changes once lexed, so the trees of functions parsed one at a time all share the same one.
+        class SyntaxTree
+        {
+        private:
+            std::shared_ptr<const TokenStream> m_Tokens{};
+            std::vector<Statement>             m_Statements{};
+            std::vector<NodeId>                m_Children{};
+            std::vector<u32>                   m_TokenRefs{};
+            std::vector<NodeId>                m_Globals{};
+            std::vector<i64>                   m_Constants{};
 
-        public:
-            static Type String(const Token& string_token) noexcept;
+            // Writes the arrays out and reads them back as they are.
+            friend class cmm::cmc::AstCache;
 
         public:
-            static std::optional<Type> FromToken(const Token& token) noexcept;
+            // A tree owns every statement and token of a program, so it's only ever moved from phase to phase.
+            SyntaxTree()                             = default;
+            SyntaxTree(SyntaxTree&&)                 = default;
+            SyntaxTree& operator=(SyntaxTree&&)      = default;
+            SyntaxTree(const SyntaxTree&)            = delete;
+            SyntaxTree& operator=(const SyntaxTree&) = delete;
 
         public:
-            inline bool        IsArray() const noexcept { return length > 0; }
-            inline bool        IsVoid() const noexcept { return ftype == FundamentalType::Void; }
-            inline std::string ToString() const noexcept
+            inline usize                   Size() const noexcept { return m_Statements.size(); }
+            inline const Statement&        operator[](const NodeId id) const noexcept { return m_Statements[id]; }
+            inline std::span<const NodeId> GetGlobals() const noexcept { return m_Globals; }
+            inline const TokenStream&      GetTokenStream() const noexcept { return *m_Tokens; }
+            inline std::span<const NodeId> GetChildren(const NodeId id) const noexcept
             {
-                std::string str{};
-                if (IsArray())
-                    str = name + "[" + std::to_string(length) + "]";
-                else
-                    str = name;
-                return str;
+                return { m_Children.data() + m_Statements[id].first_child, m_Statements[id].child_count };
             }
-
-        public:
-            inline bool operator==(const Type& type) const noexcept
+            inline NodeId GetChild(const NodeId id, const usize idx) const noexcept
             {
-                return this->ftype == type.ftype && this->name == type.name && this->length == type.length;
+                return m_Children[m_Statements[id].first_child + idx];
+            }
+            inline std::span<const u32> GetTokenRefs(const NodeId id) const noexcept
+            {
+                return { m_TokenRefs.data() + m_Statements[id].first_token, m_Statements[id].token_count };
+            }
+            inline bool IsFoldedLiteral(const NodeId id) const noexcept
+            {
+                return m_Statements[id].kind == StatementKind::LiteralExpression && m_Statements[id].token_count == 0;
             }
-        };
 
-        struct Statement
-        {
         public:
-            std::string            name{};
-            StatementKind          kind{};
-            std::vector<Statement> children{};
-            Type                   type{};
-            std::vector<Token>     tokens{};
+            // Returns the statement's idx-th token or an empty one if it doesn't have that many.
+            Token                GetToken(const NodeId id, const usize idx) const noexcept;
+            std::optional<Token> FindToken(const NodeId id, const TokenType type) const noexcept;
+
+            // The value of a number, character or boolean literal, whether it was written or folded.
+            i64 GetLiteralValue(const NodeId id) const noexcept;
 
         public:
-            std::optional<Token> GetToken(const TokenType& type) const noexcept;
+            void   SetTokenStream(TokenStream tokens);
+            void   ShareTokenStream(const SyntaxTree& tree) noexcept;
+            NodeId Add(Statement stmt, const std::span<const NodeId> children, const std::span<const u32> tokens);
+            void   AddGlobal(const NodeId id);
+
+            // Rewrites a statement in place, its id and whatever refers to it stay the same.
+            void Replace(const NodeId id, const NodeId with) noexcept;
+            void ReplaceWithLiteral(const NodeId id, const i64 value);
+
+            // Appends a tree parsed out of the same token stream, its statements get ids following ours.
+            void Append(const SyntaxTree& part);
         };
+    } // namespace ast
+
+    // A diagnostic thrown by a parser that was told not to print it and exit.
+    class ParseError : public std::runtime_error
+    {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    class Parser
+    {
+    public:
+        // Statements nest without limit but expressions are still parsed recursively, so how deep they can nest is
+        // bounded to stay well within the native stack.
+        static constexpr usize DefaultMaxExpressionDepth = 1024;
 
-        using SyntaxTree = std::vector<ast::Statement>;
+        // ParseParallel() never hands a worker less than this many tokens, smaller programs are parsed in one go.
+        static constexpr usize DefaultMinParallelTokenCount = 1 << 16;
 
-        struct Symbol
+    private:
+        // Where a statement's children and tokens start on the pending stacks.
+        struct PendingMark
         {
-            std::string    name{};
-            ast::Statement statement;
+            usize children{};
+            usize tokens{};
         };
 
-        struct SymbolTable
+        // What a call needs to know about the function it calls.
+        struct FunctionSignature
         {
-        private:
-            std::unordered_map<std::string, Symbol> m_Symbols{};
+            ast::TypeId              type{};
+            std::vector<ast::TypeId> parameters{};
+        };
 
-        public:
-            void          AddSymbol(Symbol symbol) noexcept;
-            bool          ContainsSymbol(const std::string& name) const noexcept;
-            Symbol&       GetSymbol(const std::string& name) noexcept;
-            const Symbol& GetSymbol(const std::string& name) const noexcept;
+        using NamedSignature = std::pair<SymbolId, FunctionSignature>;
+
+        // A block, if or while statement whose nested statements are still being parsed.
+        struct OpenStatement
+        {
+            ast::Statement stmt{};
+            PendingMark    mark{};
+            Token          body_token{}; // Where the body of an if or while should start.
         };
-    } // namespace ast
 
-    class Parser
-    {
     private:
-        std::string_view              m_Source{};
-        Lexer                         m_Lexer{};
-        std::optional<Token>          m_CurrentToken{};
-        std::vector<ast::Statement>   m_GlobalStatements{};
-        std::vector<ast::SymbolTable> m_SymbolTableStack{};
+        std::string_view               m_Source{};
+        TokenStream                    m_Tokens{};
+        usize                          m_TokenIndex{};
+        Token                          m_CurrentToken{};
+        ast::SyntaxTree                m_Tree{};
+        const TokenStream*             m_SharedTokens{}; // Only set for workers of ParseParallel().
+        bool                           m_ThrowErrors{};
+        bool                           m_Started{}; // Whether ParseNextFunction() has taken the tokens over yet.
+        ScopedSymbolTable<ast::NodeId> m_Symbols{};
+
+        // Every function declared so far, the table never leaves its outermost scope.
+        ScopedSymbolTable<FunctionSignature> m_Functions{};
+
+        // Children and tokens of the statements still being parsed pile up on these. A finished statement takes
+        // everything above the mark it took when it started, which keeps every statement's ranges contiguous.
+        std::vector<ast::NodeId> m_PendingChildren{};
+        std::vector<u32>         m_PendingTokens{};
+
+        usize m_ExpressionDepth{};
+        usize m_MaxExpressionDepth    = DefaultMaxExpressionDepth;
+        usize m_MinParallelTokenCount = DefaultMinParallelTokenCount;
+
+        // Only built once a diagnostic needs a line and a column.
+        mutable std::optional<LineIndex> m_LineIndex{};
 
     public:
         explicit Parser(const std::string_view source) noexcept;
+        explicit Parser(TokenStream tokens) noexcept;
+
+    public:
+        inline void SetMaxExpressionDepth(const usize depth) noexcept { m_MaxExpressionDepth = depth; }
+
+        // Lowered by the tests so that even a small program is split up between workers.
+        inline void SetMinParallelTokenCount(const usize count) noexcept
+        {
+            m_MinParallelTokenCount = count > 0 ? count : 1;
+        }
+
+        // Throw a ParseError instead of printing the diagnostic and exiting, for parsers on a thread of their own.
+        inline void SetThrowErrors(const bool throw_errors) noexcept { m_ThrowErrors = throw_errors; }
 
     public:
-        std::vector<ast::Statement> Parse();
+        // Hands the tree over to the caller, the parser is spent afterwards.
+        ast::SyntaxTree Parse() &&;
+
+        // Like Parse() but the top level functions are split up between workers and parsed at the same time. The tree
+        // and any diagnostic are exactly the same as Parse()'s.
+        ast::SyntaxTree ParseParallel(usize workers = 0) &&;
+
+        // Parses the next top level function into a tree of its own, which shares its token stream with the others.
+        // Nothing once the tokens run out.
+        std::optional<ast::SyntaxTree> ParseNextFunction();
+
+    private:
+        void                                       TakeTokens();
+        void                                       ParseSerially();
+        Parser                                     MakeWorker(const usize first) const;
+        std::optional<std::vector<NamedSignature>> ParseSignatures(const std::span<const usize> bounds) const;
+        std::optional<ast::SyntaxTree>             ParseFunctions(const usize first, const usize last,
+                                                                  const std::span<const NamedSignature> earlier) const;
 
     private:
-        std::optional<Token>          Consume() noexcept;
-        std::optional<Token>          Peek() noexcept;
-        std::optional<ast::Statement> GetStatement(const ast::StatementKind kind) const noexcept;
-        std::optional<ast::Statement> ExpectFunctionDecl();
-        std::optional<ast::Statement> ExpectImportDirective();
-        ast::Statement                ExpectFunctionParameterList();
-        std::optional<ast::Statement> ExpectLocalStatement();
-        std::optional<ast::Statement> ExpectBlockStatement();
-        std::optional<ast::Statement> ExpectVariableDeclaration();
-        std::optional<ast::Statement> ExpectKeyword();
-        std::optional<ast::Statement> ExpectExpression();
-        std::optional<ast::Statement> ExpectPrimaryExpression();
-        std::optional<ast::Statement> ExpectLiteral();
-        std::optional<ast::Statement> ExpectIdentifierName();
-        std::optional<ast::Statement> ExpectInitializerList();
-        std::optional<ast::Statement> ExpectFunctionCall();
-        ast::Statement                ExpectFunctionArgumentList();
-        std::optional<ast::Statement> ExpectAssignment();
-        std::optional<ast::Statement> ExpectAddition();
-        std::optional<ast::Statement> ExpectCondition();
-        std::optional<ast::Statement> ExpectMultiplication();
+        Token                      Consume() noexcept;
+        Token                      ConsumeAndKeep();
+        Token                      Peek(const usize k = 1) const noexcept;
+        const TokenStream&         GetTokens() const noexcept;
+        Token                      GetStatementToken(const ast::NodeId id, const usize idx) const noexcept;
+        [[noreturn]] void          ReportError(const Token& token, const std::string& message) const;
+        SourceLocation             Locate(const Token& token) const;
+        PendingMark                Mark() const noexcept;
+        ast::NodeId                Finish(const PendingMark& mark, ast::Statement stmt);
+        std::optional<ast::NodeId> GetStatement(const ast::StatementKind kind) const noexcept;
+        std::optional<ast::NodeId> ExpectFunctionDecl();
+        ast::TypeId                ExpectReturnType();
+        void                       DeclareFunction(const ast::NodeId fn);
+        std::optional<ast::NodeId> ExpectImportDirective();
+        ast::NodeId                ExpectFunctionParameterList();
+        std::optional<ast::NodeId> ExpectLocalStatement();
+        OpenStatement              OpenBlockStatement();
+        OpenStatement              OpenConditionalStatement();
+        std::optional<ast::NodeId> ExpectSimpleStatement();
+        std::optional<ast::NodeId> ExpectVariableDeclaration();
+        std::optional<ast::NodeId> ExpectKeyword();
+        std::optional<ast::NodeId> ExpectExpression();
+        std::optional<ast::NodeId> ExpectPrimaryExpression();
+        std::optional<ast::NodeId> ExpectLiteral();
+        std::optional<ast::NodeId> ExpectIdentifierName();
+        std::optional<ast::NodeId> ExpectInitializerList();
+        std::optional<ast::NodeId> ExpectFunctionCall();
+        ast::NodeId                ExpectFunctionArgumentList();
+        std::optional<ast::NodeId> ExpectAssignment();
+        std::optional<ast::NodeId> ExpectBinaryExpression(const u8 min_power);
+        std::optional<ast::NodeId> ExpectUnaryExpression();
+        void                       EnterExpression();
+        ast::NodeId                MakeBinary(const ast::StatementKind kind, const ast::TypeId type, const u32 op_token,
+                                              const ast::NodeId lhs, const ast::NodeId rhs);
     };
 } // namespace cmm::cmc
 
@@ -215,6 +327,10 @@ namespace nlohmann {
                 case SubtractionExpression: j = "SubtractionExpression"; break;
                 case MultiplicationExpression: j = "MultiplicationExpression"; break;
                 case DivisionExpression: j = "DivisionExpression"; break;
+                case LogicalAndExpression: j = "LogicalAndExpression"; break;
+                case LogicalOrExpression: j = "LogicalOrExpression"; break;
+                case LogicalNotExpression: j = "LogicalNotExpression"; break;
+                case NegationExpression: j = "NegationExpression"; break;
                 case IfStatement: j = "IfStatement"; break;
                 case ElseIfStatement: j = "ElseIfStatement"; break;
                 case ElseStatement: j = "ElseStatement"; break;
@@ -258,24 +374,13 @@ namespace nlohmann {
         {
             j["name"]   = type.name;
             j["ftype"]  = type.ftype;
-            j["fields"] = type.fields;
+            j["fields"] = ordered_json::array();
+            for (const auto field : type.fields)
+                j["fields"].push_back(cmm::cmc::ast::TypeOf(field));
             j["length"] = type.length;
             j["size"]   = type.size;
         }
     };
-
-    template <>
-    struct adl_serializer<cmm::cmc::ast::Statement>
-    {
-        static void to_json(ordered_json& j, const cmm::cmc::ast::Statement& s)
-        {
-            j["name"]     = s.name;
-            j["kind"]     = s.kind;
-            j["children"] = s.children;
-            j["type"]     = s.type;
-            j["tokens"]   = s.tokens;
-        }
-    };
 } // namespace nlohmann
 
 namespace std {
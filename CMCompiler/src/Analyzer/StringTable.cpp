@@ -0,0 +1,94 @@
+#include "StringTable.h"
+
+#include <cstring>
+
+namespace cmm::cmc {
+    namespace {
+        constexpr SymbolId EmptySlot = ~(SymbolId)0;
+
+        // FNV-1a, identifiers are short enough for a byte at a time hash to not matter.
+        constexpr u64 Hash(const std::string_view str) noexcept
+        {
+            u64 hash = 0xcbf29ce484222325ull;
+            for (const char c : str)
+                hash = (hash ^ (u8)c) * 0x100000001b3ull;
+            return hash;
+        }
+    } // namespace
+
+    StringTable::StringTable()
+    {
+        m_Slots.assign(1024, EmptySlot);
+        Intern("");
+    }
+
+    StringTable& StringTable::Global() noexcept
+    {
+        static StringTable table{};
+        return table;
+    }
+
+    SymbolId StringTable::Intern(const std::string_view str)
+    {
+        const u64   hash = Hash(str);
+        const usize mask = m_Slots.size() - 1;
+        for (usize slot = hash & mask;; slot = (slot + 1) & mask)
+        {
+            const SymbolId id = m_Slots[slot];
+            if (id == EmptySlot)
+            {
+                const auto new_id = (SymbolId)m_Strings.size();
+                m_Strings.push_back(Store(str));
+                m_Hashes.push_back(hash);
+                m_Slots[slot] = new_id;
+
+                // Keep the load factor at or below a half.
+                if (m_Strings.size() * 2 > m_Slots.size())
+                    Rehash(m_Slots.size() * 2);
+                return new_id;
+            }
+            if (m_Hashes[id] == hash && m_Strings[id] == str)
+                return id;
+        }
+    }
+
+    std::string_view StringTable::Store(const std::string_view str)
+    {
+        if (str.empty())
+            return {};
+
+        // Anything too big to share a block gets one of its own, which goes in front of the block currently being
+        // filled.
+        if (str.size() > BlockSize / 4)
+        {
+            auto block = std::make_unique<char[]>(str.size());
+            std::memcpy(block.get(), str.data(), str.size());
+            const char* data = block.get();
+            m_Blocks.insert(m_Blocks.end() - (m_Blocks.empty() ? 0 : 1), std::move(block));
+            return { data, str.size() };
+        }
+
+        if (BlockSize - m_BlockUsed < str.size())
+        {
+            m_Blocks.push_back(std::make_unique<char[]>(BlockSize));
+            m_BlockUsed = 0;
+        }
+        char* dst = m_Blocks.back().get() + m_BlockUsed;
+        std::memcpy(dst, str.data(), str.size());
+        m_BlockUsed += str.size();
+        return { dst, str.size() };
+    }
+
+    void StringTable::Rehash(const usize slot_count)
+    {
+        m_Slots.assign(slot_count, EmptySlot);
+        const usize mask = slot_count - 1;
+        for (SymbolId id = 0; id < (SymbolId)m_Strings.size(); ++id)
+        {
+            usize slot = m_Hashes[id] & mask;
+            while (m_Slots[slot] != EmptySlot)
+                slot = (slot + 1) & mask;
+            m_Slots[slot] = id;
+        }
+    }
+} // namespace cmm::cmc
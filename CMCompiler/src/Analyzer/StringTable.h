@@ -0,0 +1,61 @@
+#ifndef CMC_ANALYZER_STRING_TABLE_H
+#define CMC_ANALYZER_STRING_TABLE_H
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include <CommonDef.h>
+
+namespace cmm::cmc {
+    // Dense id of an interned string. The empty string is always 0 so a default constructed id means no name.
+    using SymbolId = u32;
+
+    // Stores every distinct string once and hands out a SymbolId for it, so names can be compared and hashed as plain
+    // integers. The lexer interns every identifier into the global table. Interning is not thread safe, it's only
+    // ever done from one thread at a time.
+    class StringTable
+    {
+    private:
+        static constexpr usize BlockSize = 64 * 1024;
+
+    private:
+        // Interned strings are copied into blocks that never move, so the views stay valid for as long as the table.
+        std::vector<std::unique_ptr<char[]>> m_Blocks{};
+        usize                                m_BlockUsed = BlockSize;
+        std::vector<std::string_view>        m_Strings{};
+        std::vector<u64>                     m_Hashes{};
+
+        // Open addressed with linear probing, each slot holds a SymbolId or EmptySlot.
+        std::vector<SymbolId> m_Slots{};
+
+    public:
+        StringTable();
+        StringTable(const StringTable&) = delete;
+
+    public:
+        StringTable& operator=(const StringTable&) = delete;
+
+    public:
+        static StringTable& Global() noexcept;
+
+    public:
+        inline usize            Size() const noexcept { return m_Strings.size(); }
+        inline std::string_view Get(const SymbolId id) const noexcept { return m_Strings[id]; }
+
+    public:
+        SymbolId Intern(const std::string_view str);
+
+    private:
+        std::string_view Store(const std::string_view str);
+        void             Rehash(const usize slot_count);
+    };
+
+    // Shorthand for looking a name up in the global table.
+    inline std::string_view NameOf(const SymbolId id) noexcept
+    {
+        return StringTable::Global().Get(id);
+    }
+} // namespace cmm::cmc
+
+#endif // CMC_ANALYZER_STRING_TABLE_H
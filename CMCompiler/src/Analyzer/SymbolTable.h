@@ -0,0 +1,124 @@
+#ifndef CMC_ANALYZER_SYMBOL_TABLE_H
+#define CMC_ANALYZER_SYMBOL_TABLE_H
+
+#include <vector>
+
+#include "StringTable.h"
+
+namespace cmm::cmc {
+    // Every name visible at some point of a program, in a single table for all scopes. Declarations are kept on a
+    // stack in the order they were made and an open addressed hash maps each name to its newest declaration, which in
+    // turn links to the one it shadows. Entering a scope remembers the top of the stack and leaving it unwinds back
+    // there, putting every shadowed declaration back in place.
+    template <typename T>
+    class ScopedSymbolTable
+    {
+    public:
+        // Index of a declaration, stays valid until the scope it was declared in is left.
+        using Handle = u32;
+
+        static constexpr Handle NoHandle = ~(Handle)0;
+
+    private:
+        static constexpr SymbolId EmptySlot = ~(SymbolId)0;
+
+    private:
+        struct Declaration
+        {
+            SymbolId name{};
+            Handle   shadowed{};
+            T        value{};
+        };
+
+        // A slot keeps its name once claimed, a name whose declarations all went out of scope just has no newest one.
+        struct Slot
+        {
+            SymbolId name   = EmptySlot;
+            Handle   newest = NoHandle;
+        };
+
+    private:
+        std::vector<Declaration> m_Declarations{};
+        std::vector<Handle>      m_Scopes{};
+        std::vector<Slot>        m_Slots = std::vector<Slot>(64);
+        usize                    m_UsedSlots{};
+
+    public:
+        inline usize GetScopeDepth() const noexcept { return m_Scopes.size(); }
+        inline T&    Get(const Handle handle) noexcept { return m_Declarations[handle].value; }
+
+    public:
+        inline void PushScope() { m_Scopes.push_back((Handle)m_Declarations.size()); }
+        inline void PopScope() noexcept
+        {
+            const Handle first = m_Scopes.back();
+            m_Scopes.pop_back();
+            while (m_Declarations.size() > first)
+            {
+                const auto& decl = m_Declarations.back();
+                auto&       slot = m_Slots[FindSlot(decl.name)];
+                slot.newest      = decl.shadowed;
+                m_Declarations.pop_back();
+            }
+        }
+
+        Handle Declare(const SymbolId name, T value)
+        {
+            auto slot = FindSlot(name);
+            if (m_Slots[slot].name == EmptySlot)
+            {
+                // Keep the load factor at or below a half.
+                if ((m_UsedSlots + 1) * 2 > m_Slots.size())
+                {
+                    Rehash(m_Slots.size() * 2);
+                    slot = FindSlot(name);
+                }
+                m_Slots[slot].name = name;
+                ++m_UsedSlots;
+            }
+
+            const auto handle = (Handle)m_Declarations.size();
+            m_Declarations.push_back(
+                Declaration{ .name = name, .shadowed = m_Slots[slot].newest, .value = std::move(value) });
+            m_Slots[slot].newest = handle;
+            return handle;
+        }
+
+        // The innermost declaration of the name or NoHandle if it's not visible.
+        inline Handle Find(const SymbolId name) const noexcept { return m_Slots[FindSlot(name)].newest; }
+
+        // Like Find but only looks at the current scope, for catching redeclarations.
+        inline Handle FindInScope(const SymbolId name) const noexcept
+        {
+            const Handle handle = Find(name);
+            if (handle == NoHandle || m_Scopes.empty() || handle < m_Scopes.back())
+                return NoHandle;
+            return handle;
+        }
+
+    private:
+        usize FindSlot(const SymbolId name) const noexcept
+        {
+            // Ids are dense so a multiplicative hash spreads them well enough.
+            const usize mask = m_Slots.size() - 1;
+            for (usize slot = ((u64)name * 0x9e3779b97f4a7c15ull) >> 32 & mask;; slot = (slot + 1) & mask)
+            {
+                if (m_Slots[slot].name == name || m_Slots[slot].name == EmptySlot)
+                    return slot;
+            }
+        }
+
+        void Rehash(const usize slot_count)
+        {
+            auto old = std::move(m_Slots);
+            m_Slots.assign(slot_count, Slot{});
+            for (const auto& e : old)
+            {
+                if (e.name != EmptySlot)
+                    m_Slots[FindSlot(e.name)] = e;
+            }
+        }
+    };
+} // namespace cmm::cmc
+
+#endif // CMC_ANALYZER_SYMBOL_TABLE_H
@@ -0,0 +1,77 @@
+#include "TypeTable.h"
+
+namespace cmm::cmc::ast {
+    usize TypeTable::Hash::operator()(const Type& type) const noexcept
+    {
+        usize hash = std::hash<std::string>{}(type.name);
+        hash       = hash * 31 + (usize)type.ftype;
+        hash       = hash * 31 + type.element;
+        hash       = hash * 31 + type.length;
+        for (const auto field : type.fields)
+            hash = hash * 31 + field;
+        return hash;
+    }
+
+    TypeTable::TypeTable()
+    {
+        // Interned in the order of the constants in the header.
+        Intern(Type{});
+        Intern(Type{ .name = "Integer32", .ftype = FundamentalType::Integer32, .size = 32 });
+        Intern(Type{ .name = "Integer64", .ftype = FundamentalType::Integer64, .size = 64 });
+        Intern(Type{ .name = "Character8", .ftype = FundamentalType::Character, .size = 8 });
+        Intern(Type{ .name = "Boolean", .ftype = FundamentalType::Boolean, .size = 8 });
+
+        // A string's length belongs to its literal, not its type.
+        Intern(Type{ .name = "CString", .ftype = FundamentalType::String });
+    }
+
+    TypeTable& TypeTable::Global() noexcept
+    {
+        static TypeTable table{};
+        return table;
+    }
+
+    TypeId TypeTable::Intern(Type type)
+    {
+        std::lock_guard lock{ m_Mutex };
+        if (auto it = m_Ids.find(type); it != m_Ids.end())
+            return it->second;
+
+        // The id is only handed out once the type is in place, so whoever gets to see it can read the type unlocked.
+        const auto  id      = (TypeId)m_Size;
+        const usize segment = std::bit_width(id / FirstSegmentSize + 1) - 1;
+        if (!m_Segments[segment])
+            m_Segments[segment] = std::make_unique<Type[]>(FirstSegmentSize << segment);
+        m_Ids.emplace(type, id);
+        m_Segments[segment][id - FirstSegmentSize * ((1ull << segment) - 1)] = std::move(type);
+        ++m_Size;
+        return id;
+    }
+
+    TypeId TypeTable::ArrayOf(const TypeId element, const usize length)
+    {
+        // An array keeps the name, kind and size of its element so code that only looks at those treats it alike.
+        Type array    = Get(element);
+        array.element = element;
+        array.length  = length;
+        return Intern(std::move(array));
+    }
+
+    std::optional<TypeId> TypeTable::FromToken(const Token& token)
+    {
+        switch (token.type)
+        {
+            using enum TokenType;
+
+            case KeywordI32: return Integer32;
+            case KeywordI64: return Integer64;
+            case KeywordString: return String;
+            case KeywordChar: return Character;
+            case KeywordBool: return Boolean;
+            case Identifier:
+                return Intern(Type{ .name = std::string{ token.span.text }, .ftype = FundamentalType::UserDefined });
+            default: break;
+        }
+        return std::nullopt;
+    }
+} // namespace cmm::cmc::ast
@@ -0,0 +1,129 @@
+#ifndef CMC_ANALYZER_TYPE_TABLE_H
+#define CMC_ANALYZER_TYPE_TABLE_H
+
+#include <array>
+#include <bit>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Lexer.h"
+
+namespace cmm::cmc::ast {
+    enum class FundamentalType : u8
+    {
+        Void,
+        Integer32,
+        Integer64,
+        Boolean,
+        Character,
+        String,
+        UserDefined
+    };
+
+    // Dense id of an interned type. Void is always 0 so a default constructed id means no type.
+    using TypeId = u32;
+
+    struct Type
+    {
+    public:
+        std::string         name = "Void";
+        FundamentalType     ftype{};
+        std::vector<TypeId> fields{};  // For user defined types.
+        TypeId              element{}; // The type of one element (for arrays).
+        usize               length{};  // In element count (for arrays).
+        i8                  size{};    // In bits.
+
+    public:
+        inline bool        IsArray() const noexcept { return length > 0; }
+        inline bool        IsVoid() const noexcept { return ftype == FundamentalType::Void; }
+        inline std::string ToString() const noexcept
+        {
+            std::string str{};
+            if (IsArray())
+                str = name + "[" + std::to_string(length) + "]";
+            else
+                str = name;
+            return str;
+        }
+
+    public:
+        // The size follows from the rest so it takes no part in telling two types apart.
+        inline bool operator==(const Type& type) const noexcept
+        {
+            return this->ftype == type.ftype && this->name == type.name && this->element == type.element &&
+                   this->length == type.length && this->fields == type.fields;
+        }
+    };
+
+    // Stores every distinct type once and hands out a TypeId for it, so the tree and the symbol tables carry a plain
+    // integer and two types are the same exactly when their ids are. Arrays and user defined types are interned like
+    // any other type. Functions are parsed on several threads at once so interning takes a lock, looking a type up
+    // doesn't since an interned type never moves.
+    class TypeTable
+    {
+    public:
+        static constexpr TypeId Void      = 0;
+        static constexpr TypeId Integer32 = 1;
+        static constexpr TypeId Integer64 = 2;
+        static constexpr TypeId Character = 3;
+        static constexpr TypeId Boolean   = 4;
+        static constexpr TypeId String    = 5;
+
+    private:
+        struct Hash
+        {
+            usize operator()(const Type& type) const noexcept;
+        };
+
+        // Segment k holds FirstSegmentSize << k types, together they have room for every possible TypeId.
+        static constexpr usize FirstSegmentSize = 64;
+        static constexpr usize SegmentCount     = 26;
+
+    private:
+        // Segments are never reallocated so references to interned types stay valid while new ones are added.
+        std::array<std::unique_ptr<Type[]>, SegmentCount> m_Segments{};
+        usize                                             m_Size{};
+        std::unordered_map<Type, TypeId, Hash>            m_Ids{};
+        mutable std::mutex                                m_Mutex{};
+
+    public:
+        TypeTable();
+        TypeTable(const TypeTable&) = delete;
+
+    public:
+        TypeTable& operator=(const TypeTable&) = delete;
+
+    public:
+        static TypeTable& Global() noexcept;
+
+    public:
+        inline const Type& Get(const TypeId id) const noexcept
+        {
+            const usize segment = std::bit_width(id / FirstSegmentSize + 1) - 1;
+            return m_Segments[segment][id - FirstSegmentSize * ((1ull << segment) - 1)];
+        }
+
+        inline usize Size() const
+        {
+            std::lock_guard lock{ m_Mutex };
+            return m_Size;
+        }
+
+    public:
+        TypeId                Intern(Type type);
+        TypeId                ArrayOf(const TypeId element, const usize length);
+        std::optional<TypeId> FromToken(const Token& token);
+    };
+
+    // Shorthand for looking a type up in the global table.
+    inline const Type& TypeOf(const TypeId id) noexcept
+    {
+        return TypeTable::Global().Get(id);
+    }
+} // namespace cmm::cmc::ast
+
+#endif // CMC_ANALYZER_TYPE_TABLE_H
@@ -0,0 +1,67 @@
+#ifndef CMC_COMPILER_BOUNDED_QUEUE_H
+#define CMC_COMPILER_BOUNDED_QUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+#include <CommonDef.h>
+
+namespace cmm::cmc {
+    // Hands items from one thread to another. A producer that gets too far ahead waits for the consumer to catch up,
+    // so no more than the capacity is ever in flight.
+    template <typename T>
+    class BoundedQueue
+    {
+    private:
+        std::deque<T>           m_Items{};
+        usize                   m_Capacity{};
+        bool                    m_Closed{};
+        std::mutex              m_Mutex{};
+        std::condition_variable m_NotEmpty{};
+        std::condition_variable m_NotFull{};
+
+    public:
+        explicit BoundedQueue(const usize capacity) noexcept : m_Capacity(capacity == 0 ? 1 : capacity) {}
+
+    public:
+        // Waits for room for the item, or drops it and returns false once the queue is closed.
+        bool Push(T item)
+        {
+            std::unique_lock lock{ m_Mutex };
+            m_NotFull.wait(lock, [this] { return m_Items.size() < m_Capacity || m_Closed; });
+            if (m_Closed)
+                return false;
+
+            m_Items.push_back(std::move(item));
+            m_NotEmpty.notify_one();
+            return true;
+        }
+
+        // Waits for the next item, nothing once the queue is closed and all of its items are taken.
+        std::optional<T> Pop()
+        {
+            std::unique_lock lock{ m_Mutex };
+            m_NotEmpty.wait(lock, [this] { return !m_Items.empty() || m_Closed; });
+            if (m_Items.empty())
+                return std::nullopt;
+
+            auto item = std::move(m_Items.front());
+            m_Items.pop_front();
+            m_NotFull.notify_one();
+            return item;
+        }
+
+        // No more items are coming, or the consumer stopped taking them. The items already in are still handed out.
+        void Close()
+        {
+            std::lock_guard lock{ m_Mutex };
+            m_Closed = true;
+            m_NotEmpty.notify_all();
+            m_NotFull.notify_all();
+        }
+    };
+} // namespace cmm::cmc
+
+#endif // CMC_COMPILER_BOUNDED_QUEUE_H
@@ -1,54 +1,152 @@
 #include "Compiler.h"
 
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <thread>
+
+#include <fmt/core.h>
+
+#include "../Analyzer/ConstantFolder.h"
+#include "../Analyzer/LineIndex.h"
+#include "BoundedQueue.h"
+
 namespace cmm::cmc {
     using ast::FundamentalType;
+    using ast::NodeId;
     using ast::Statement;
     using ast::StatementKind;
     using ast::SyntaxTree;
-    using ast::Type;
+    using ast::TypeOf;
     using namespace rlang;
     using namespace rlang::alvm;
 
-    namespace codegen {
-        void SymbolTable::AddSymbol(Symbol symbol) noexcept
+    using namespace codegen;
+
+    namespace {
+        bool IsScalar(const ast::Type& type) noexcept
         {
-            m_Symbol[symbol.name] = std::move(symbol);
-            m_Offset += symbol.size;
+            switch (type.ftype)
+            {
+                using enum FundamentalType;
+
+                case Boolean:
+                case Character:
+                case Integer32:
+                case Integer64:
+                case String: return !type.IsArray(); // A string is the address of its characters.
+                default: break;
+            }
+            return false;
         }
 
-        bool SymbolTable::ContainsSymbol(const std::string& name) const noexcept
+        // The registers a binary operation takes depending on which side is evaluated first, given what each side
+        // takes. The left hand side's register receives the result while the right hand side's is only read, so
+        // whichever is evaluated first has its register held while the other one is.
+        u32 GetLeftFirstRegisters(const u32 lhs, const u32 rhs) noexcept
         {
-            return m_Symbol.contains(name);
+            return std::max(lhs, rhs + 1);
         }
 
-        Symbol& SymbolTable::GetSymbol(const std::string& name) noexcept
+        u32 GetRightFirstRegisters(const u32 lhs, const u32 rhs) noexcept
         {
-            return m_Symbol[name];
+            return std::max(rhs, lhs + (rhs != 0));
         }
+    } // namespace
 
-        const Symbol& SymbolTable::GetSymbol(const std::string& name) const noexcept
+    Compiler::Compiler()
+        : m_PrintI64(StringTable::Global().Intern("printi64")), m_PrintStr(StringTable::Global().Intern("printstr"))
+    {
+    }
+
+    Compiler::Compiler(SyntaxTree tree) : Compiler()
+    {
+        m_Tree = std::move(tree);
+    }
+
+    usize StringPool::Intern(const std::string_view text)
+    {
+        if (text.empty())
+            return NullAddress;
+
+        const auto [it, inserted] = m_Addresses.try_emplace(std::string{ text }, m_Data.size());
+        if (inserted)
         {
-            return ((SymbolTable*)this)->GetSymbol(name);
+            m_Data.insert(m_Data.end(), text.begin(), text.end());
+            m_Data.push_back(0);
         }
-    } // namespace codegen
-
-    using namespace codegen;
+        return it->second;
+    }
 
-    RegType GetReg(const usize idx) noexcept
+    CompiledProgram Compiler::CompilePipelined(TokenStream tokens, const usize capacity)
     {
-        constexpr RegType r = RegType::R0;
-        return (RegType)((usize)r + idx);
+        Compiler                   compiler{};
+        BoundedQueue<SyntaxTree>   queue{ capacity };
+        std::optional<std::string> error{};
+        std::exception_ptr         failure{};
+
+        // Parse errors are thrown rather than exiting from under us and get reported once both threads are done,
+        // anything else the parser throws is rethrown on this thread. The queue is closed however the parser stops.
+        std::jthread parser_thread{ [&] {
+            try
+            {
+                auto parser = Parser(std::move(tokens));
+                parser.SetThrowErrors(true);
+                while (auto fn = parser.ParseNextFunction())
+                {
+                    if (!queue.Push(std::move(*fn)))
+                        break;
+                }
+            }
+            catch (const ParseError& e)
+            {
+                error = e.what();
+            }
+            catch (...)
+            {
+                failure = std::current_exception();
+            }
+            queue.Close();
+        } };
+
+        try
+        {
+            while (auto fn = queue.Pop())
+                compiler.CompileFunctions(std::move(*fn));
+        }
+        catch (...)
+        {
+            // The parser may be waiting for room in the queue, closing it lets the thread finish and be joined as
+            // it goes out of scope.
+            queue.Close();
+            throw;
+        }
+        parser_thread.join();
+
+        if (failure)
+            std::rethrow_exception(failure);
+        if (error)
+        {
+            std::cerr << *error << std::endl;
+            std::exit(-1);
+        }
+        return std::move(compiler).Finish();
     }
 
-    Compiler::Compiler(SyntaxTree tree) : m_Tree(std::move(tree))
+    CompiledProgram Compiler::Compile() &&
     {
+        CompileFunctions(std::move(m_Tree));
+        return std::move(*this).Finish();
     }
 
-    InstructionList Compiler::Compile()
+    void Compiler::CompileFunctions(SyntaxTree tree)
     {
-        for (const auto& s : m_Tree)
+        m_Tree = std::move(tree);
+        ast::ConstantFolder(m_Tree).Fold();
+        LabelExpressions();
+        for (const auto s : m_Tree.GetGlobals())
         {
-            switch (s.kind)
+            switch (m_Tree[s].kind)
             {
                 using enum StatementKind;
 
@@ -57,32 +155,48 @@ namespace cmm::cmc {
                 default: break;
             }
         }
+
+        // Nothing refers to the tree once the code is generated, don't keep it around for as long as we live.
+        m_Tree   = {};
+        m_Labels = {};
+    }
+
+    CompiledProgram Compiler::Finish() &&
+    {
         m_CompiledCode.push_back(Instruction{ .opcode = OpCode::End });
-        return m_CompiledCode;
+        return CompiledProgram{ .code = std::move(m_CompiledCode), .data = m_Strings.TakeData() };
     }
 
-    void Compiler::CompileFunctionBody(const Statement& fnStmt)
+    void Compiler::CompileFunctionBody(const NodeId fnStmt)
     {
-        for (const auto& s : fnStmt.children)
+        // Virtual registers are numbered and allocated one function at a time.
+        m_Operands.clear();
+        m_RegisterCount = 0;
+        m_FunctionStart = m_CompiledCode.size();
+
+        for (const auto s : m_Tree.GetChildren(fnStmt))
         {
-            if (s.kind == StatementKind::BlockStatement)
+            if (m_Tree[s].kind == StatementKind::BlockStatement)
             {
                 CompileBlockStatement(s);
             }
         }
+
+        m_Allocator.Allocate(m_CompiledCode, m_Operands, m_FunctionStart, m_RegisterCount);
     }
 
-    void Compiler::CompileBlockStatement(const Statement& block)
+    void Compiler::CompileBlockStatement(const NodeId block)
     {
-        m_SymbolTableStack.push_back(SymbolTable{});
+        m_Symbols.PushScope();
+        m_BlockFrames.push_back(BlockFrame{});
 
-        m_CompiledCode.push_back(Instruction{ .opcode = OpCode::Push, .sreg = RegType::BP });
-        m_CompiledCode.push_back(Instruction{ .opcode = OpCode::Mov, .sreg = RegType::SP, .dreg = RegType::BP });
+        Emit(Instruction{ .opcode = OpCode::Push, .sreg = RegType::BP });
+        Emit(Instruction{ .opcode = OpCode::Mov, .sreg = RegType::SP, .dreg = RegType::BP });
         // m_CompiledCode.push_back(Instruction{ .opcode = OpCode::Pushar });
 
-        for (const auto& s : block.children)
+        for (const auto s : m_Tree.GetChildren(block))
         {
-            switch (s.kind)
+            switch (m_Tree[s].kind)
             {
                 using enum StatementKind;
 
@@ -92,73 +206,79 @@ namespace cmm::cmc {
             }
         }
 
-        m_SymbolTableStack.pop_back();
+        m_BlockFrames.pop_back();
+        m_Symbols.PopScope();
         // m_CompiledCode.push_back(Instruction{ .opcode = OpCode::Popar });
-        m_CompiledCode.push_back(Instruction{ .opcode = OpCode::Leave });
+        Emit(Instruction{ .opcode = OpCode::Leave });
     }
 
-    void Compiler::CompileVariableDeclaration(const Statement& var)
+    void Compiler::CompileVariableDeclaration(const NodeId id)
     {
-        // Grab our current block's symbol table.
-        auto& current_table = m_SymbolTableStack.back();
+        // Grab our current block's frame.
+        auto&       current_frame = m_BlockFrames.back();
+        const auto& var           = m_Tree[id];
+        const auto& var_type      = TypeOf(var.type);
 
         Symbol sym{};
-        sym.stmt    = var;
+        sym.stmt    = id;
         sym.name    = var.name;
         sym.kind    = SymbolKind::Variable;
-        sym.size    = (var.type.size / 8) * ((var.type.length == 0) ? 1 : var.type.length);
-        sym.address = current_table.GetOffset();
+        sym.size    = (var_type.size / 8) * ((var_type.length == 0) ? 1 : var_type.length);
+        sym.address = current_frame.GetOffset();
+
+        // A scalar lives in a virtual register of its own rather than in the frame, it only goes to memory if the
+        // allocator runs out of registers while it's still needed.
+        if (IsScalar(var_type))
+        {
+            if (var.child_count != 0)
+                sym.reg = CompileInitializer(m_Tree.GetChild(id, 0));
+            else
+            {
+                // Zero, or the empty string for a string.
+                static_assert(StringPool::NullAddress == 0);
+                sym.reg = NewRegister();
+                Emit(Instruction{ .opcode = OpCode::Mov, .imm64 = 0 }, NoRegister, sym.reg);
+            }
+            m_Symbols.Declare(sym.name, sym);
+            return;
+        }
 
         // Initialized.
-        if (!var.children.empty())
+        if (var.child_count != 0)
         {
-            auto current_offset = current_table.GetOffset();
+            auto current_offset = current_frame.GetOffset();
 
             // We know that a variable declaration statement will always have an Initializer statement if initialized
             // (but of course).
-            m_CompiledCode.push_back(Instruction{
-                .opcode = OpCode::Mov, .sreg = RegType::SP, .dreg = GetReg(current_table.GetUsedRegisters()++) });
-            CompileInitializer(var.children[0]);
-            switch (sym.stmt.type.ftype)
+            const auto saved_sp = NewRegister();
+            Emit(Instruction{ .opcode = OpCode::Mov, .sreg = RegType::SP }, NoRegister, saved_sp);
+            const auto value = CompileInitializer(m_Tree.GetChild(id, 0));
+            switch (TypeOf(m_Tree[sym.stmt].type).ftype)
             {
                 using enum FundamentalType;
 
-                case String: {
-                    for (i32 i = 0; i < ; ++i)
-                    {
-                        m_CompiledCode.push_back(Instruction{ .opcode = OpCode::Pop,
-                                                              .sreg   = GetReg(current_table.GetUsedRegisters()++),
-                                                              .size   = (i8)Type::Character.size });
-                        m_CompiledCode.push_back(Instruction{ .opcode = OpCode::Store,
-                                                              .sreg   = GetReg(--current_table.GetUsedRegisters()),
-                                                              .dreg   = MemReg(RegType::BP),
-                                                              .disp   = current_table.GetOffset(),
-                                                              .size   = (i8)var.type.size });
-                    }
-                    break;
-                }
-
+                // Arrays, whose elements are laid out in the frame.
                 case Character:
                 case Boolean:
                 case Integer32:
                 case Integer64: {
-                    m_CompiledCode.push_back(Instruction{ .opcode = OpCode::Store,
-                                                          .sreg   = GetReg(--current_table.GetUsedRegisters()),
-                                                          .dreg   = MemReg(RegType::BP),
-                                                          .disp   = current_table.GetOffset(),
-                                                          .size   = (i8)var.type.size });
+                    Emit(Instruction{ .opcode = OpCode::Store,
+                                      .dreg   = MemReg(RegType::BP),
+                                      .disp   = current_frame.GetOffset(),
+                                      .size   = (i8)var_type.size },
+                         value);
                     break;
                 }
                 default: break;
             }
-            m_CompiledCode.push_back(Instruction{
-                .opcode = OpCode::Mov, .sreg = GetReg(--current_table.GetUsedRegisters()), .dreg = RegType::SP });
-            current_table.AddSymbol(sym);
+            Emit(Instruction{ .opcode = OpCode::Mov, .dreg = RegType::SP }, saved_sp);
+            m_Symbols.Declare(sym.name, sym);
+            current_frame.GetOffset() += sym.size;
         }
         else
         {
             // Just allocate space on the stack.
-            switch (var.type.ftype)
+            switch (var_type.ftype)
             {
                 using enum FundamentalType;
 
@@ -166,86 +286,118 @@ namespace cmm::cmc {
                 case Character:
                 case Integer32:
                 case Integer64:
-                    m_CompiledCode.push_back(Instruction{ .opcode = OpCode::Store,
-                                                          .dreg   = MemReg(RegType::BP),
-                                                          .disp   = current_table.GetOffset(),
-                                                          .size   = (i8)var.type.size });
+                    Emit(Instruction{ .opcode = OpCode::Store,
+                                      .dreg   = MemReg(RegType::BP),
+                                      .disp   = current_frame.GetOffset(),
+                                      .size   = (i8)var_type.size });
                     break;
-                // FIXME: Uninitilized strings do not allocate space.
-                case String: break;
                 default: break;
             }
         }
     }
 
-    void Compiler::CompileInitializer(const Statement& init)
+    VirtualRegister Compiler::CompileInitializer(const NodeId init)
     {
         // Check if the initializer's value is a value, expression or a initializer list.
-        CompileExpression(init.children[0]);
+        return CompileExpression(m_Tree.GetChild(init, 0));
     }
 
-    void Compiler::CompileExpression(const ast::Statement& expr)
+    VirtualRegister Compiler::CompileExpression(const NodeId id)
     {
-        auto& current_table = m_SymbolTableStack.back();
+        const auto& expr = m_Tree[id];
         switch (expr.kind)
         {
             using enum StatementKind;
 
-            case FunctionCallExpression: {
-                break;
-            }
-            case FunctionArgumentList: {
-                break;
-            }
             case LiteralExpression: {
-                CompileLiteral(expr);
-                break;
+                return CompileLiteral(id);
             }
             case AdditionExpression:
-            case SubtractionExpression: {
-                CompileExpression(expr.children[0]);
-                CompileExpression(expr.children[1]);
-
-                auto&      used_regs = current_table.GetUsedRegisters();
-                const auto op_code   = (expr.kind == AdditionExpression) ? OpCode::Add : OpCode::Sub;
-                m_CompiledCode.push_back(
-                    Instruction{ .opcode = op_code, .sreg = GetReg(--used_regs), .dreg = GetReg(used_regs - 1) });
-                break;
-            }
+            case SubtractionExpression:
             case DivisionExpression:
             case MultiplicationExpression: {
-                CompileExpression(expr.children[0]);
-                CompileExpression(expr.children[1]);
-
-                auto&      used_regs = current_table.GetUsedRegisters();
-                const auto op_code   = (expr.kind == DivisionExpression) ? OpCode::Div : OpCode::Mul;
-                m_CompiledCode.push_back(
-                    Instruction{ .opcode = op_code, .sreg = GetReg(--used_regs), .dreg = GetReg(used_regs - 1) });
-                break;
+                // The left hand side's register takes the result, the right hand side's is only read. Evaluating the
+                // side that needs more registers first doesn't change which is which, so this holds for subtraction
+                // and division too.
+                VirtualRegister lhs{};
+                VirtualRegister rhs{};
+                if (EvaluatesRightFirst(id))
+                {
+                    rhs = CompileOperand(m_Tree.GetChild(id, 1));
+                    lhs = CompileExpression(m_Tree.GetChild(id, 0));
+                }
+                else
+                {
+                    lhs = CompileExpression(m_Tree.GetChild(id, 0));
+                    rhs = CompileOperand(m_Tree.GetChild(id, 1));
+                }
+
+                OpCode op_code{};
+                switch (expr.kind)
+                {
+                    case AdditionExpression: op_code = OpCode::Add; break;
+                    case SubtractionExpression: op_code = OpCode::Sub; break;
+                    case MultiplicationExpression: op_code = OpCode::Mul; break;
+                    default: op_code = OpCode::Div; break;
+                }
+                Emit(Instruction{ .opcode = op_code }, rhs, lhs);
+                return lhs;
+            }
+            case NegationExpression: {
+                // There's no negate instruction so subtract the operand from a zero, which is only loaded once the
+                // operand is done.
+                const auto operand = CompileOperand(m_Tree.GetChild(id, 0));
+                const auto result  = NewRegister();
+                Emit(Instruction{ .opcode = OpCode::Mov, .imm64 = 0 }, NoRegister, result);
+                Emit(Instruction{ .opcode = OpCode::Sub }, operand, result);
+                return result;
             }
 
             case IdentifierName: {
-                auto& sym = m_SymbolTableStack.back().GetSymbol(expr.name);
-                m_CompiledCode.push_back(Instruction{ .opcode  = OpCode::Lea,
-                                                      .sreg    = GetReg(current_table.GetUsedRegisters()++),
-                                                      .disp    = sym.address,
-                                                      .src_reg = RegType::BP });
-                break;
+                return CompileIdentifierName(id);
             }
             default: break;
         }
+
+        // Comparisons, logical operators and calls have no value to take, carrying on would leave whatever uses
+        // theirs reading a register nothing was ever written to.
+        const auto token = m_Tree.GetToken(id, 0);
+        ReportError(id, fmt::format("'{}' can't be compiled as part of an expression yet.", token.span.text));
+    }
+
+    VirtualRegister Compiler::CompileOperand(const NodeId id)
+    {
+        // A variable that's only read is used right where it lives instead of being copied first.
+        if (m_Tree[id].kind == StatementKind::IdentifierName)
+        {
+            const auto decl = m_Symbols.Find(m_Tree[id].name);
+            if (decl != m_Symbols.NoHandle && m_Symbols.Get(decl).reg != NoRegister)
+                return m_Symbols.Get(decl).reg;
+        }
+        return CompileExpression(id);
     }
 
-    void Compiler::CompileLiteral(const Statement& literal)
+    VirtualRegister Compiler::CompileIdentifierName(const NodeId ident)
     {
-        // Grab our current block's symbol table.
-        auto& current_table = m_SymbolTableStack.back();
+        // The value ends up in a register the caller may overwrite, so a variable living in one is copied.
+        const auto decl   = m_Symbols.Find(m_Tree[ident].name);
+        const auto result = NewRegister();
+        if (decl != m_Symbols.NoHandle && m_Symbols.Get(decl).reg != NoRegister)
+        {
+            Emit(Instruction{ .opcode = OpCode::Mov }, m_Symbols.Get(decl).reg, result);
+            return result;
+        }
 
-        // The literal token.
-        auto& literal_token = literal.tokens[0];
+        // Variables declared without an initializer have no storage yet and sit at the frame's base.
+        const auto address = (decl != m_Symbols.NoHandle) ? m_Symbols.Get(decl).address : 0;
+        Emit(Instruction{ .opcode = OpCode::Lea, .disp = address, .src_reg = RegType::BP }, result);
+        return result;
+    }
 
+    VirtualRegister Compiler::CompileLiteral(const NodeId literal)
+    {
         // We support fundamental types only for now.
-        switch (literal.type.ftype)
+        switch (TypeOf(m_Tree[literal].type).ftype)
         {
             using enum FundamentalType;
 
@@ -254,58 +406,49 @@ namespace cmm::cmc {
             case Character:
             case Integer32:
             case Integer64: {
-                m_CompiledCode.push_back(Instruction{ .opcode = OpCode::Mov,
-                                                      .imm64  = (u64)literal_token.num,
-                                                      .dreg   = GetReg(current_table.GetUsedRegisters()++) });
-                break;
+                const auto result = NewRegister();
+                Emit(Instruction{ .opcode = OpCode::Mov, .imm64 = (u64)m_Tree.GetLiteralValue(literal) }, NoRegister,
+                     result);
+                return result;
             }
             case String: {
-                auto offset = current_table.GetOffset();
-                for (char c : literal_token.span.text)
-                {
-                    m_CompiledCode.push_back(
-                        Instruction{ .opcode = OpCode::Push, .imm64 = (u64)c, .size = (i8)(Type::Character.size / 8) });
-                    offset += Type::Character.size / 8;
-                }
-                m_CompiledCode.push_back(
-                    Instruction{ .opcode = OpCode::Push, .imm64 = 0, .size = (i8)(Type::Character.size / 8) });
-                break;
+                const auto result  = NewRegister();
+                const auto address = m_Strings.Intern(m_Tree.GetToken(literal, 0).span.text);
+                Emit(Instruction{ .opcode = OpCode::Mov, .imm64 = (u64)address }, NoRegister, result);
+                return result;
             }
 
             default: break;
         }
+        return NoRegister;
     }
 
-    void Compiler::CompileInitializerList(const ast::Statement& initList)
+    void Compiler::CompileInitializerList(const NodeId initList)
     {
-        // Grab our current block's symbol table.
-        auto& current_table = m_SymbolTableStack.back();
+        // Grab our current block's frame.
+        auto& current_frame = m_BlockFrames.back();
 
-        auto prev_offset = current_table.GetOffset();
-        for (const auto& expr : initList.children)
+        auto prev_offset = current_frame.GetOffset();
+        for (const auto expr : m_Tree.GetChildren(initList))
         {
             CompileExpression(expr);
-            current_table.GetOffset() += expr.type.size / 8;
+            current_frame.GetOffset() += TypeOf(m_Tree[expr].type).size / 8;
         }
 
-        current_table.GetOffset() = prev_offset;
+        current_frame.GetOffset() = prev_offset;
     }
 
-    void Compiler::CompileFunctionCall(const ast::Statement& fnCall)
+    void Compiler::CompileFunctionCall(const NodeId id)
     {
-        auto& current_table = m_SymbolTableStack.back();
-        if (fnCall.name == "printi64")
+        const auto& fnCall = m_Tree[id];
+        if (fnCall.name == m_PrintI64)
         {
-            CompileFunctionArgumentList(fnCall.children[0]);
-            m_CompiledCode.push_back(
-                Instruction{ .opcode = OpCode::PInt, .sreg = GetReg(--current_table.GetUsedRegisters()) });
+            Emit(Instruction{ .opcode = OpCode::PInt }, CompileFunctionArgumentList(m_Tree.GetChild(id, 0)));
             return;
         }
-        else if (fnCall.name == "printstr")
+        else if (fnCall.name == m_PrintStr)
         {
-            CompileFunctionArgumentList(fnCall.children[0]);
-            m_CompiledCode.push_back(
-                Instruction{ .opcode = OpCode::PStr, .sreg = GetReg(--current_table.GetUsedRegisters()) });
+            Emit(Instruction{ .opcode = OpCode::PStr }, CompileFunctionArgumentList(m_Tree.GetChild(id, 0)));
             return;
         }
 
@@ -313,20 +456,96 @@ namespace cmm::cmc {
         {
             if (fn.name == fnCall.name)
             {
-                m_CompiledCode.push_back(Instruction{ .opcode = OpCode::Call, .imm64 = fn.address });
-                for (const auto& arg : fnCall.children[0].children)
-                {
-                    CompileExpression(arg);
-                }
+                Emit(Instruction{ .opcode = OpCode::Call, .imm64 = fn.address });
+                CompileFunctionArgumentList(m_Tree.GetChild(id, 0));
             }
         }
     }
 
-    void Compiler::CompileFunctionArgumentList(const ast::Statement& args)
+    VirtualRegister Compiler::CompileFunctionArgumentList(const NodeId args)
     {
-        for (const auto& arg : args.children)
+        VirtualRegister last = NoRegister;
+        for (const auto arg : m_Tree.GetChildren(args))
         {
-            CompileExpression(arg);
+            last = CompileOperand(arg);
         }
+        return last;
+    }
+
+    void Compiler::LabelExpressions()
+    {
+        // A statement always comes after its children in the tree, so they're labelled by the time it is.
+        m_Labels.assign(m_Tree.Size(), ExpressionLabel{});
+        for (NodeId id = 0; id < m_Tree.Size(); ++id)
+        {
+            auto& label = m_Labels[id];
+            for (const auto child : m_Tree.GetChildren(id))
+                label.effects = label.effects || m_Labels[child].effects;
+
+            switch (m_Tree[id].kind)
+            {
+                using enum StatementKind;
+
+                case FunctionCallExpression:
+                case AssignmentExpression: label.effects = true; break;
+
+                case AdditionExpression:
+                case SubtractionExpression:
+                case MultiplicationExpression:
+                case DivisionExpression: {
+                    const auto lhs  = m_Labels[m_Tree.GetChild(id, 0)].registers;
+                    const auto rhs  = GetOperandRegisters(m_Tree.GetChild(id, 1));
+                    label.registers = EvaluatesRightFirst(id) ? GetRightFirstRegisters(lhs, rhs)
+                                                              : GetLeftFirstRegisters(lhs, rhs);
+                    break;
+                }
+                case NegationExpression: {
+                    // The operand's register, if it needs one, is held while the zero it's subtracted from is loaded.
+                    const auto operand = GetOperandRegisters(m_Tree.GetChild(id, 0));
+                    label.registers    = std::max(operand, (operand != 0) + 1u);
+                    break;
+                }
+                default: break;
+            }
+        }
+    }
+
+    u32 Compiler::GetOperandRegisters(const NodeId expr) const noexcept
+    {
+        // A variable that's only read is used right where it lives.
+        const auto& stmt = m_Tree[expr];
+        if (stmt.kind == StatementKind::IdentifierName && IsScalar(TypeOf(stmt.type)))
+            return 0;
+        return m_Labels[expr].registers;
+    }
+
+    bool Compiler::EvaluatesRightFirst(const NodeId expr) const noexcept
+    {
+        const auto lhs = m_Tree.GetChild(expr, 0);
+        const auto rhs = m_Tree.GetChild(expr, 1);
+        if (m_Labels[lhs].effects || m_Labels[rhs].effects)
+            return false;
+
+        const auto lhs_registers = m_Labels[lhs].registers;
+        const auto rhs_registers = GetOperandRegisters(rhs);
+        return GetRightFirstRegisters(lhs_registers, rhs_registers) <
+               GetLeftFirstRegisters(lhs_registers, rhs_registers);
+    }
+
+    void Compiler::ReportError(const NodeId id, const std::string& message) const
+    {
+        const auto location = LineIndex(m_Tree.GetTokenStream().GetSource()).Locate(m_Tree.GetToken(id, 0).span.offset);
+        throw CompileError(fmt::format("Compile Error @ line ({}, {}): {}", location.line, location.column, message));
+    }
+
+    VirtualRegister Compiler::NewRegister() noexcept
+    {
+        return m_RegisterCount++;
+    }
+
+    void Compiler::Emit(const Instruction& instruction, const VirtualRegister sreg, const VirtualRegister dreg)
+    {
+        m_CompiledCode.push_back(instruction);
+        m_Operands.push_back(VirtualOperands{ .sreg = sreg, .dreg = dreg });
     }
 } // namespace cmm::cmc
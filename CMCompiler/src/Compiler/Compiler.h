@@ -2,9 +2,14 @@
 #define CMC_COMPILER_H
 
 #include <ALVM.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include "../Analyzer/Parser.h"
+#include "RegisterAllocator.h"
 
 namespace cmm::cmc {
     namespace codegen {
@@ -17,67 +22,152 @@ namespace cmm::cmc {
 
         struct Symbol
         {
-            std::string    name{};
-            SymbolKind     kind{};
-            ast::Statement stmt{};
-            usize          size{};
-            i32            address{};
+            SymbolId        name{};
+            SymbolKind      kind{};
+            ast::NodeId     stmt{};
+            usize           size{};
+            i32             address{};
+            VirtualRegister reg = NoRegister; // Where a scalar variable lives instead of an address.
         };
 
-        struct SymbolTable
+        // What a block statement keeps track of while it's being compiled, its symbols live in the compiler's
+        // scoped symbol table.
+        struct BlockFrame
         {
         private:
-            std::unordered_map<std::string, Symbol> m_Symbol{};
-            i32                                     m_Offset{};
-            usize                                   m_UsedRegisters{};
+            i32 m_Offset{};
 
         public:
-            inline i32&         GetOffset() noexcept { return m_Offset; }
-            inline const i32&   GetOffset() const noexcept { return m_Offset; }
-            inline usize&       GetUsedRegisters() noexcept { return m_UsedRegisters; };
-            inline const usize& GetUsedRegisters() const noexcept { return m_UsedRegisters; };
+            inline i32&       GetOffset() noexcept { return m_Offset; }
+            inline const i32& GetOffset() const noexcept { return m_Offset; }
+        };
 
-        public:
-            void          AddSymbol(Symbol symbol) noexcept;
-            bool          ContainsSymbol(const std::string& name) const noexcept;
-            Symbol&       GetSymbol(const std::string& name) noexcept;
-            const Symbol& GetSymbol(const std::string& name) const noexcept;
+        // What code generation needs to know about an expression before compiling it.
+        struct ExpressionLabel
+        {
+            u32  registers = 1; // The most registers evaluating it takes at once, its Sethi-Ullman number.
+            bool effects{};     // Whether it does anything besides computing a value, it's then never reordered.
         };
 
         struct FunctionDefinition
         {
-            std::string name{};
-            usize       address{};
+            SymbolId name{};
+            usize    address{};
         };
 
-        struct StringPool
+        // Every distinct string literal of the program, laid out once in the data segment the VM's memory starts out
+        // with. A string is the address of its first character there and ends at a NUL.
+        class StringPool
         {
+        public:
+            // What a string declared without a value points to. No literal is ever placed there, the segment starts
+            // with a lone NUL so it reads as the empty string.
+            static constexpr usize NullAddress = 0;
+
+        private:
+            std::vector<u8>                        m_Data{ 0 };
+            std::unordered_map<std::string, usize> m_Addresses{};
+
+        public:
+            // The address of a string with this text, which is only added if there isn't one yet.
+            usize Intern(const std::string_view text);
+
+            // Hands the data segment over, the pool is empty afterwards.
+            inline std::vector<u8> TakeData()
+            {
+                auto data = std::move(m_Data);
+                m_Data    = { 0 };
+                m_Addresses.clear();
+                return data;
+            }
+        };
+
+        // What the VM runs, the code and the memory image it starts with.
+        struct CompiledProgram
+        {
+            rlang::alvm::InstructionList code{};
+            std::vector<u8>              data{};
         };
     } // namespace codegen
 
+    // A diagnostic for a program that parses but has something in it the compiler can't generate code for.
+    class CompileError : public std::runtime_error
+    {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
     class Compiler
     {
+    public:
+        // How many parsed functions CompilePipelined() lets wait for code generation.
+        static constexpr usize DefaultPipelineCapacity = 16;
+
     private:
         ast::SyntaxTree                          m_Tree{};
         rlang::alvm::InstructionList             m_CompiledCode{};
         std::vector<codegen::FunctionDefinition> m_CompiledFunctions{};
-        std::vector<codegen::SymbolTable>        m_SymbolTableStack{};
+        ScopedSymbolTable<codegen::Symbol>       m_Symbols{};
+        std::vector<codegen::BlockFrame>         m_BlockFrames{};
+        std::vector<codegen::ExpressionLabel>    m_Labels{}; // For every statement of the tree.
+        codegen::StringPool                      m_Strings{};
+
+        // The virtual registers of the function being compiled, one entry for each of its instructions so far.
+        std::vector<codegen::VirtualOperands> m_Operands{};
+        codegen::VirtualRegister              m_RegisterCount{};
+        usize                                 m_FunctionStart{};
+        codegen::RegisterAllocator            m_Allocator{};
+
+        // The built-ins are interned up front, nothing may be interned while a parser runs on another thread.
+        SymbolId m_PrintI64{};
+        SymbolId m_PrintStr{};
+
+    public:
+        Compiler();
+        explicit Compiler(ast::SyntaxTree tree);
 
     public:
-        Compiler(ast::SyntaxTree tree);
+        // Parses and compiles one function at a time, the parser running on a thread of its own a few functions
+        // ahead. Only the functions waiting in between are ever in memory rather than the whole program's tree.
+        static codegen::CompiledProgram CompilePipelined(TokenStream tokens,
+                                                         const usize capacity = DefaultPipelineCapacity);
 
     public:
-        rlang::alvm::InstructionList Compile();
-        void                         CompileFunctionBody(const ast::Statement& fnStmt);
-        void                         CompileBlockStatement(const ast::Statement& block);
-        void                         CompileVariableDeclaration(const ast::Statement& var);
-        void                         CompileInitializer(const ast::Statement& init);
-        void                         CompileExpression(const ast::Statement& expr);
-        void                         CompileLiteral(const ast::Statement& literal);
-        void                         CompileInitializerList(const ast::Statement& initList);
-        void                         CompileFunctionCall(const ast::Statement& fnCall);
-        void                         CompileIdentifierName(const ast::Statement& ident);
-        void                         CompileFunctionArgumentList(const ast::Statement& args);
+        // How many values had to be kept in memory because they didn't fit in the registers.
+        inline usize GetSpillCount() const noexcept { return m_Allocator.GetSpillCount(); }
+
+    public:
+        // Hands the compiled program over to the caller, the compiler is spent afterwards.
+        codegen::CompiledProgram Compile() &&;
+
+        // Compiles the functions of a tree and lets go of it, Finish() then hands the program over.
+        void                     CompileFunctions(ast::SyntaxTree tree);
+        codegen::CompiledProgram Finish() &&;
+        void                     CompileFunctionBody(const ast::NodeId fnStmt);
+        void                     CompileBlockStatement(const ast::NodeId block);
+        void                     CompileVariableDeclaration(const ast::NodeId var);
+        codegen::VirtualRegister CompileInitializer(const ast::NodeId init);
+        codegen::VirtualRegister CompileExpression(const ast::NodeId expr);
+        codegen::VirtualRegister CompileOperand(const ast::NodeId expr);
+        codegen::VirtualRegister CompileLiteral(const ast::NodeId literal);
+        void                     CompileInitializerList(const ast::NodeId initList);
+        void                     CompileFunctionCall(const ast::NodeId fnCall);
+        codegen::VirtualRegister CompileIdentifierName(const ast::NodeId ident);
+        codegen::VirtualRegister CompileFunctionArgumentList(const ast::NodeId args);
+
+    private:
+        void                     LabelExpressions();
+        u32                      GetOperandRegisters(const ast::NodeId expr) const noexcept;
+        bool                     EvaluatesRightFirst(const ast::NodeId expr) const noexcept;
+        codegen::VirtualRegister NewRegister() noexcept;
+
+        // Throws a CompileError located at the statement's first token.
+        [[noreturn]] void ReportError(const ast::NodeId id, const std::string& message) const;
+
+        // Appends an instruction whose sreg and dreg, where given, are virtual registers.
+        void Emit(const rlang::alvm::Instruction& instruction,
+                  const codegen::VirtualRegister  sreg = codegen::NoRegister,
+                  const codegen::VirtualRegister  dreg = codegen::NoRegister);
     };
 } // namespace cmm::cmc
 
@@ -0,0 +1,340 @@
+#include "PeepholeOptimizer.h"
+
+#include <algorithm>
+
+namespace cmm::cmc::codegen {
+    using namespace rlang::alvm;
+
+    namespace {
+        // Whether an operand is a register or addresses memory through it.
+        bool Mentions(const RegType operand, const RegType reg) noexcept
+        {
+            return operand == reg || operand == MemReg(reg);
+        }
+
+        bool IsGeneralRegister(const RegType reg) noexcept
+        {
+            return (u8)reg <= (u8)RegType::R15;
+        }
+
+        // Whether we know everything an instruction does to registers. Nothing is assumed about what comes after
+        // anything else, it ends whatever a pattern is looking at.
+        bool IsStraightLine(const OpCode op) noexcept
+        {
+            switch (op)
+            {
+                case OpCode::Nop:
+                case OpCode::Mov:
+                case OpCode::Lea:
+                case OpCode::Store:
+                case OpCode::Load:
+                case OpCode::Add:
+                case OpCode::Sub:
+                case OpCode::Mul:
+                case OpCode::Div:
+                case OpCode::Cmp:
+                case OpCode::Push:
+                case OpCode::Pop:
+                case OpCode::Leave:
+                case OpCode::PInt:
+                case OpCode::PStr: return true;
+                default: break;
+            }
+            return false;
+        }
+
+        bool Reads(const Instruction& instruction, const RegType reg) noexcept
+        {
+            switch (instruction.opcode)
+            {
+                case OpCode::Nop: return false;
+                case OpCode::Lea: return Mentions(instruction.src_reg, reg);
+                case OpCode::Pop: return reg == RegType::SP;
+                case OpCode::Push: return reg == RegType::SP || Mentions(instruction.sreg, reg);
+                case OpCode::Leave: return reg == RegType::BP;
+                case OpCode::Store:
+                case OpCode::Add:
+                case OpCode::Sub:
+                case OpCode::Mul:
+                case OpCode::Div:
+                case OpCode::Cmp: return Mentions(instruction.sreg, reg) || Mentions(instruction.dreg, reg);
+                default: break;
+            }
+            return Mentions(instruction.sreg, reg);
+        }
+
+        bool Writes(const Instruction& instruction, const RegType reg) noexcept
+        {
+            switch (instruction.opcode)
+            {
+                case OpCode::Nop:
+                case OpCode::Store:
+                case OpCode::Cmp:
+                case OpCode::PInt:
+                case OpCode::PStr: return false;
+                case OpCode::Lea: return instruction.sreg == reg;
+                case OpCode::Pop: return instruction.sreg == reg || reg == RegType::SP;
+                case OpCode::Push: return reg == RegType::SP;
+                case OpCode::Leave: return reg == RegType::SP || reg == RegType::BP;
+                default: break;
+            }
+            return instruction.dreg == reg;
+        }
+
+        // Code that moves somewhere by address can't have instructions taken out from under it.
+        bool IsTransfer(const OpCode op) noexcept
+        {
+            switch (op)
+            {
+                case OpCode::Call:
+                case OpCode::Ret:
+                case OpCode::Jmp:
+                case OpCode::Je:
+                case OpCode::Jne: return true;
+                default: break;
+            }
+            return false;
+        }
+
+        // The next instruction that's still there after pos.
+        usize Next(const InstructionList& code, usize pos) noexcept
+        {
+            do
+                ++pos;
+            while (pos < code.size() && code[pos].opcode == OpCode::Nop);
+            return pos;
+        }
+
+        // Whether the value of a register after pos is written over before anything reads it. What the program ends
+        // with is up to the VM, so everything is still needed at the end.
+        bool IsDead(const InstructionList& code, const usize pos, const RegType reg) noexcept
+        {
+            usize seen = 0;
+            for (usize i = Next(code, pos); i < code.size() && seen++ < PeepholeOptimizer::Window; i = Next(code, i))
+            {
+                const auto& instruction = code[i];
+                if (!IsStraightLine(instruction.opcode) || Reads(instruction, reg))
+                    return false;
+                if (Writes(instruction, reg))
+                    return true;
+            }
+            return false;
+        }
+
+        void Remove(Instruction& instruction) noexcept
+        {
+            instruction = Instruction{ .opcode = OpCode::Nop };
+        }
+    } // namespace
+
+    std::string_view GetPeepholePatternName(const PeepholePattern pattern) noexcept
+    {
+        switch (pattern)
+        {
+            using enum PeepholePattern;
+
+            case RedundantFrame: return "redundant frame";
+            case PushPop: return "push/pop pair";
+            case RedundantMove: return "redundant move";
+            case MoveChain: return "move chain";
+            case DeadMove: return "dead move";
+            case StoreImmediate: return "store immediate";
+            default: break;
+        }
+        return "unknown";
+    }
+
+    PeepholeOptimizer::PeepholeOptimizer() noexcept
+    {
+        m_Enabled.set();
+    }
+
+    void PeepholeOptimizer::Optimize(InstructionList& code)
+    {
+        // Every pattern leaves fewer instructions behind, so this ends.
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (usize pos = 0; pos < code.size(); ++pos)
+            {
+                if (code[pos].opcode != OpCode::Nop)
+                    changed = Apply(code, pos) || changed;
+            }
+        }
+
+        if (std::none_of(code.begin(), code.end(), [](const Instruction& i) { return IsTransfer(i.opcode); }))
+            std::erase_if(code, [](const Instruction& i) { return i.opcode == OpCode::Nop; });
+    }
+
+    bool PeepholeOptimizer::Apply(InstructionList& code, const usize pos)
+    {
+        for (usize pattern = 0; pattern < PatternCount; ++pattern)
+        {
+            if (!m_Enabled[pattern])
+                continue;
+
+            bool applied{};
+            switch ((PeepholePattern)pattern)
+            {
+                using enum PeepholePattern;
+
+                case RedundantFrame: applied = RemoveRedundantFrame(code, pos); break;
+                case PushPop: applied = FoldPushPop(code, pos); break;
+                case RedundantMove: applied = RemoveRedundantMove(code, pos); break;
+                case MoveChain: applied = CollapseMoveChain(code, pos); break;
+                case DeadMove: applied = RemoveDeadMove(code, pos); break;
+                case StoreImmediate: applied = FoldStoreImmediate(code, pos); break;
+                default: break;
+            }
+            if (applied)
+            {
+                ++m_Hits[pattern];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool PeepholeOptimizer::RemoveRedundantFrame(InstructionList& code, const usize pos) const
+    {
+        if (code[pos].opcode != OpCode::Push || code[pos].sreg != RegType::BP)
+            return false;
+
+        const auto mov = Next(code, pos);
+        if (mov == code.size() || code[mov].opcode != OpCode::Mov || code[mov].sreg != RegType::SP ||
+            code[mov].dreg != RegType::BP)
+            return false;
+
+        // The frame is only there for the stack and base pointers, a block that never uses either doesn't need it.
+        for (auto i = Next(code, mov); i < code.size(); i = Next(code, i))
+        {
+            const auto& instruction = code[i];
+            if (instruction.opcode == OpCode::Leave)
+            {
+                Remove(code[pos]);
+                Remove(code[mov]);
+                Remove(code[i]);
+                return true;
+            }
+            if (!IsStraightLine(instruction.opcode) || instruction.opcode == OpCode::Push ||
+                instruction.opcode == OpCode::Pop)
+                return false;
+            for (const auto reg : { RegType::SP, RegType::BP })
+            {
+                if (Reads(instruction, reg) || Writes(instruction, reg))
+                    return false;
+            }
+        }
+        return false;
+    }
+
+    bool PeepholeOptimizer::FoldPushPop(InstructionList& code, const usize pos) const
+    {
+        const auto& push = code[pos];
+        const auto  pop  = Next(code, pos);
+        if (push.opcode != OpCode::Push || pop == code.size() || code[pop].opcode != OpCode::Pop)
+            return false;
+
+        // Narrower values are cut down on the way through memory, a move would keep all of them.
+        const auto& target = code[pop];
+        if (push.size != Instruction{}.size || target.size != Instruction{}.size || push.sreg == RegType::SP ||
+            target.sreg == RegType::SP)
+            return false;
+
+        if (push.sreg == target.sreg)
+            Remove(code[pos]);
+        else
+            code[pos] = Instruction{ .opcode = OpCode::Mov, .imm64 = push.imm64, .sreg = push.sreg, .dreg = target.sreg };
+        Remove(code[pop]);
+        return true;
+    }
+
+    bool PeepholeOptimizer::RemoveRedundantMove(InstructionList& code, const usize pos) const
+    {
+        const auto& mov = code[pos];
+        if (mov.opcode != OpCode::Mov)
+            return false;
+
+        if (mov.sreg == mov.dreg && mov.sreg != RegType::Nul)
+        {
+            Remove(code[pos]);
+            return true;
+        }
+
+        // Look back for the same move, or one the other way around, with neither side written to since.
+        usize seen = 0;
+        for (auto i = pos; i-- > 0 && seen++ < Window;)
+        {
+            const auto& instruction = code[i];
+            if (instruction.opcode == OpCode::Nop)
+            {
+                --seen;
+                continue;
+            }
+            if (!IsStraightLine(instruction.opcode))
+                return false;
+
+            if (instruction.opcode == OpCode::Mov && instruction.size == mov.size)
+            {
+                const bool same = instruction.sreg == mov.sreg && instruction.dreg == mov.dreg &&
+                                  (mov.sreg != RegType::Nul || instruction.imm64 == mov.imm64);
+                const bool swapped =
+                    mov.sreg != RegType::Nul && instruction.sreg == mov.dreg && instruction.dreg == mov.sreg;
+                if (same || swapped)
+                {
+                    Remove(code[pos]);
+                    return true;
+                }
+            }
+            if (Writes(instruction, mov.dreg) || (mov.sreg != RegType::Nul && Writes(instruction, mov.sreg)))
+                return false;
+        }
+        return false;
+    }
+
+    bool PeepholeOptimizer::CollapseMoveChain(InstructionList& code, const usize pos) const
+    {
+        const auto& first  = code[pos];
+        const auto  second = Next(code, pos);
+        if (first.opcode != OpCode::Mov || !IsGeneralRegister(first.dreg) || second == code.size() ||
+            code[second].opcode != OpCode::Mov || code[second].sreg != first.dreg ||
+            code[second].size != first.size || !IsDead(code, second, first.dreg))
+            return false;
+
+        code[second].sreg  = first.sreg;
+        code[second].imm64 = first.imm64;
+        Remove(code[pos]);
+        return true;
+    }
+
+    bool PeepholeOptimizer::RemoveDeadMove(InstructionList& code, const usize pos) const
+    {
+        const auto& mov = code[pos];
+        if (mov.opcode != OpCode::Mov || !IsGeneralRegister(mov.dreg) || !IsDead(code, pos, mov.dreg))
+            return false;
+
+        Remove(code[pos]);
+        return true;
+    }
+
+    bool PeepholeOptimizer::FoldStoreImmediate(InstructionList& code, const usize pos) const
+    {
+        // Stores and pushes take an immediate in place of a source register.
+        const auto& load  = code[pos];
+        const auto  store = Next(code, pos);
+        if (load.opcode != OpCode::Mov || load.sreg != RegType::Nul || !IsGeneralRegister(load.dreg) ||
+            store == code.size())
+            return false;
+
+        auto& target = code[store];
+        if ((target.opcode != OpCode::Store && target.opcode != OpCode::Push) || target.sreg != load.dreg ||
+            Mentions(target.dreg, load.dreg) || !IsDead(code, store, load.dreg))
+            return false;
+
+        target.sreg  = RegType::Nul;
+        target.imm64 = load.imm64;
+        Remove(code[pos]);
+        return true;
+    }
+} // namespace cmm::cmc::codegen
@@ -0,0 +1,67 @@
+#ifndef CMC_COMPILER_PEEPHOLE_OPTIMIZER_H
+#define CMC_COMPILER_PEEPHOLE_OPTIMIZER_H
+
+#include <ALVM.h>
+#include <array>
+#include <bitset>
+#include <string_view>
+
+#include <CommonDef.h>
+
+namespace cmm::cmc::codegen {
+    // Rewrites of a few instructions at a time that code generation leaves room for.
+    enum class PeepholePattern : u8
+    {
+        RedundantFrame, // `Push BP; Mov SP -> BP ... Leave` around code that never touches the stack.
+        PushPop,        // `Push x; Pop y` becomes `Mov x -> y`.
+        RedundantMove,  // A move of a value to where it already is.
+        MoveChain,      // `Mov x -> a; Mov a -> b` becomes `Mov x -> b` if a isn't used again.
+        DeadMove,       // A move to a register that's written again before it's read.
+        StoreImmediate, // `Mov imm -> a; Store a -> [m]` becomes `Store imm -> [m]`, the same for pushes.
+        Count
+    };
+
+    std::string_view GetPeepholePatternName(const PeepholePattern pattern) noexcept;
+
+    // Looks at the compiled program through a small window and applies every enabled pattern until none match
+    // anymore. Removed instructions are dropped unless the program jumps somewhere, they're then left as Nops so no
+    // address changes.
+    class PeepholeOptimizer
+    {
+    public:
+        static constexpr usize PatternCount = (usize)PeepholePattern::Count;
+
+        // How far the patterns look ahead or back for what a register holds, a value used further away than this is
+        // left alone.
+        static constexpr usize Window = 32;
+
+    private:
+        std::bitset<PatternCount>       m_Enabled{};
+        std::array<usize, PatternCount> m_Hits{};
+
+    public:
+        PeepholeOptimizer() noexcept;
+
+    public:
+        void Optimize(rlang::alvm::InstructionList& code);
+
+        inline void SetEnabled(const PeepholePattern pattern, const bool enabled) noexcept
+        {
+            m_Enabled.set((usize)pattern, enabled);
+        }
+
+        // How many times a pattern was applied, over every program so far.
+        inline usize GetHits(const PeepholePattern pattern) const noexcept { return m_Hits[(usize)pattern]; }
+
+    private:
+        bool Apply(rlang::alvm::InstructionList& code, const usize pos);
+        bool RemoveRedundantFrame(rlang::alvm::InstructionList& code, const usize pos) const;
+        bool FoldPushPop(rlang::alvm::InstructionList& code, const usize pos) const;
+        bool RemoveRedundantMove(rlang::alvm::InstructionList& code, const usize pos) const;
+        bool CollapseMoveChain(rlang::alvm::InstructionList& code, const usize pos) const;
+        bool RemoveDeadMove(rlang::alvm::InstructionList& code, const usize pos) const;
+        bool FoldStoreImmediate(rlang::alvm::InstructionList& code, const usize pos) const;
+    };
+} // namespace cmm::cmc::codegen
+
+#endif // CMC_COMPILER_PEEPHOLE_OPTIMIZER_H
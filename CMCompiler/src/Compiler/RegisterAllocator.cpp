@@ -0,0 +1,241 @@
+#include "RegisterAllocator.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace cmm::cmc::codegen {
+    using namespace rlang::alvm;
+
+    namespace {
+        // Which of an instruction's register operands it reads and which it writes. Loads and pops fill their source
+        // operand, arithmetic both reads and writes its destination.
+        bool WritesSource(const OpCode op) noexcept
+        {
+            return op == OpCode::Lea || op == OpCode::Pop;
+        }
+
+        bool ReadsDestination(const OpCode op) noexcept
+        {
+            switch (op)
+            {
+                case OpCode::Add:
+                case OpCode::Sub:
+                case OpCode::Mul:
+                case OpCode::Div:
+                case OpCode::Cmp: return true;
+                default: break;
+            }
+            return false;
+        }
+
+        bool WritesDestination(const OpCode op) noexcept
+        {
+            return op != OpCode::Cmp;
+        }
+
+        RegType GetRealRegister(const u8 idx) noexcept
+        {
+            return (RegType)((usize)RegType::R0 + idx);
+        }
+    } // namespace
+
+    void RegisterAllocator::Allocate(InstructionList& code, const std::span<const VirtualOperands> operands,
+                                     const usize first, const usize virtual_count)
+    {
+        ComputeIntervals(operands, virtual_count);
+        if (Scan(RegisterCount))
+        {
+            Assign(code, operands, first);
+            return;
+        }
+
+        // Spilling takes a base register and two scratch ones away, so the registers are handed out over again.
+        Scan(RegisterCount - 3);
+        AssignWithSpills(code, operands, first);
+        m_SpillCount += m_SlotCount;
+    }
+
+    void RegisterAllocator::ComputeIntervals(const std::span<const VirtualOperands> operands,
+                                             const usize virtual_count)
+    {
+        m_Intervals.assign(virtual_count, Interval{});
+        for (VirtualRegister reg = 0; reg < virtual_count; ++reg)
+            m_Intervals[reg].reg = reg;
+
+        for (u32 pos = 0; pos < operands.size(); ++pos)
+        {
+            for (const auto reg : { operands[pos].sreg, operands[pos].dreg })
+            {
+                if (reg == NoRegister)
+                    continue;
+                m_Intervals[reg].start = std::min(m_Intervals[reg].start, pos);
+                m_Intervals[reg].end   = std::max(m_Intervals[reg].end, pos);
+            }
+        }
+
+        m_Ends.resize(virtual_count);
+        for (const auto& interval : m_Intervals)
+            m_Ends[interval.reg] = interval.end;
+
+        std::erase_if(m_Intervals, [](const Interval& interval) { return interval.start > interval.end; });
+        std::stable_sort(m_Intervals.begin(), m_Intervals.end(),
+                         [](const Interval& a, const Interval& b) { return a.start < b.start; });
+        m_Assigned.assign(virtual_count, Spilled);
+        m_Slots.assign(virtual_count, 0);
+    }
+
+    bool RegisterAllocator::Scan(const usize register_count)
+    {
+        // The intervals holding a register, by where they end.
+        std::vector<const Interval*> active{};
+        const auto insert_active = [&](const Interval& interval) {
+            const auto it = std::upper_bound(active.begin(), active.end(), interval.end,
+                                             [](const u32 end, const Interval* other) { return end < other->end; });
+            active.insert(it, &interval);
+        };
+
+        u32 free_registers = (u32)((1ull << register_count) - 1);
+        m_SlotCount        = 0;
+        std::fill(m_Assigned.begin(), m_Assigned.end(), Spilled);
+        for (const auto& interval : m_Intervals)
+        {
+            // A register is free again once the last instruction using its value is behind us.
+            while (!active.empty() && active.front()->end < interval.start)
+            {
+                free_registers |= 1u << m_Assigned[active.front()->reg];
+                active.erase(active.begin());
+            }
+
+            if (free_registers == 0)
+            {
+                const auto* latest = active.back();
+                if (latest->end >= interval.end)
+                {
+                    m_Assigned[interval.reg] = m_Assigned[latest->reg];
+                    m_Assigned[latest->reg]  = Spilled;
+                    m_Slots[latest->reg]     = m_SlotCount++;
+                    active.pop_back();
+                    insert_active(interval);
+                }
+                else
+                    m_Slots[interval.reg] = m_SlotCount++;
+                continue;
+            }
+
+            const auto idx = (u8)std::countr_zero(free_registers);
+            free_registers &= ~(1u << idx);
+            m_Assigned[interval.reg] = idx;
+            insert_active(interval);
+        }
+        return m_SlotCount == 0;
+    }
+
+    void RegisterAllocator::Assign(InstructionList& code, const std::span<const VirtualOperands> operands,
+                                   const usize first) const
+    {
+        for (usize i = 0; i < operands.size(); ++i)
+        {
+            auto& instruction = code[first + i];
+            if (operands[i].sreg != NoRegister)
+                instruction.sreg = GetRealRegister(m_Assigned[operands[i].sreg]);
+            if (operands[i].dreg != NoRegister)
+                instruction.dreg = GetRealRegister(m_Assigned[operands[i].dreg]);
+        }
+    }
+
+    void RegisterAllocator::AssignWithSpills(InstructionList& code, const std::span<const VirtualOperands> operands,
+                                             const usize first) const
+    {
+        InstructionList allocated{};
+        allocated.reserve(operands.size() + operands.size() / 2 + 4);
+
+        // The spill area starts where the stack was when the function was entered and the stack moves past it. The
+        // slot right at that address is left alone and so is the one the stack ends up at, whether a push moves SP
+        // before or after writing it can then touch neither the caller's values nor ours.
+        allocated.push_back(Instruction{ .opcode = OpCode::Mov, .sreg = RegType::SP, .dreg = SpillBase });
+        allocated.push_back(
+            Instruction{ .opcode = OpCode::Mov, .imm64 = (m_SlotCount + 1) * 8ull, .dreg = SourceScratch });
+        allocated.push_back(Instruction{
+            .opcode = StackGrowsUp ? OpCode::Add : OpCode::Sub, .sreg = SourceScratch, .dreg = RegType::SP });
+
+        const auto slot_offset = [&](const VirtualRegister reg) {
+            const auto offset = (i32)(m_Slots[reg] + 1) * 8;
+            return StackGrowsUp ? offset : -offset;
+        };
+        const auto load = [&](const VirtualRegister reg, const RegType scratch) {
+            allocated.push_back(Instruction{ .opcode = OpCode::Load,
+                                             .sreg   = MemReg(SpillBase),
+                                             .dreg   = scratch,
+                                             .disp   = slot_offset(reg) });
+        };
+        const auto store = [&](const VirtualRegister reg, const RegType scratch) {
+            allocated.push_back(Instruction{ .opcode = OpCode::Store,
+                                             .sreg   = scratch,
+                                             .dreg   = MemReg(SpillBase),
+                                             .disp   = slot_offset(reg) });
+        };
+
+        // The spilled value last put in the destination scratch register stays there for as long as nothing else
+        // needs the register, so a spilled value being computed isn't written out and read back after every step. It's
+        // only written out once it has to make room and if it's still used afterwards.
+        VirtualRegister cached = NoRegister;
+        bool            dirty  = false;
+
+        for (u32 i = 0; i < operands.size(); ++i)
+        {
+            auto        instruction = code[first + i];
+            const auto  op          = instruction.opcode;
+            const auto& regs        = operands[i];
+            const bool  src_spilled = regs.sreg != NoRegister && m_Assigned[regs.sreg] == Spilled;
+            const bool  dst_spilled = regs.dreg != NoRegister && m_Assigned[regs.dreg] == Spilled;
+
+            if (src_spilled)
+            {
+                if (WritesSource(op))
+                {
+                    if (regs.sreg == cached)
+                        cached = NoRegister;
+                    instruction.sreg = SourceScratch;
+                }
+                else if (regs.sreg == cached && (!dst_spilled || regs.dreg == cached))
+                    instruction.sreg = DestinationScratch;
+                else
+                {
+                    if (regs.sreg == cached)
+                        allocated.push_back(
+                            Instruction{ .opcode = OpCode::Mov, .sreg = DestinationScratch, .dreg = SourceScratch });
+                    else
+                        load(regs.sreg, SourceScratch);
+                    instruction.sreg = SourceScratch;
+                }
+            }
+            else if (regs.sreg != NoRegister)
+                instruction.sreg = GetRealRegister(m_Assigned[regs.sreg]);
+
+            if (dst_spilled)
+            {
+                if (regs.dreg != cached)
+                {
+                    if (cached != NoRegister && dirty && m_Ends[cached] > i)
+                        store(cached, DestinationScratch);
+                    if (ReadsDestination(op))
+                        load(regs.dreg, DestinationScratch);
+                    cached = regs.dreg;
+                    dirty  = false;
+                }
+                dirty            = dirty || WritesDestination(op);
+                instruction.dreg = DestinationScratch;
+            }
+            else if (regs.dreg != NoRegister)
+                instruction.dreg = GetRealRegister(m_Assigned[regs.dreg]);
+
+            allocated.push_back(instruction);
+            if (src_spilled && WritesSource(op))
+                store(regs.sreg, SourceScratch);
+        }
+        allocated.push_back(Instruction{ .opcode = OpCode::Mov, .sreg = SpillBase, .dreg = RegType::SP });
+
+        code.resize(first);
+        code.insert(code.end(), allocated.begin(), allocated.end());
+    }
+} // namespace cmm::cmc::codegen
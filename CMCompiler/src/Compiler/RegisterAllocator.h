@@ -0,0 +1,82 @@
+#ifndef CMC_COMPILER_REGISTER_ALLOCATOR_H
+#define CMC_COMPILER_REGISTER_ALLOCATOR_H
+
+#include <ALVM.h>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include <CommonDef.h>
+
+namespace cmm::cmc::codegen {
+    // Code is generated as if there were a register for every value, numbered per function. The allocator maps them
+    // onto the VM's registers once the function is done.
+    using VirtualRegister = u32;
+
+    constexpr VirtualRegister NoRegister = std::numeric_limits<VirtualRegister>::max();
+
+    // Whether the ALVM's stack grows towards higher addresses. Every frame is laid out for it, locals sit above BP
+    // the way the VM's own frames are, and the spill area is reserved on the side of SP the stack grows towards.
+    constexpr bool StackGrowsUp = true;
+
+    // The virtual registers an instruction's sreg and dreg stand for, NoRegister for operands that are real registers
+    // (or not there).
+    struct VirtualOperands
+    {
+        VirtualRegister sreg = NoRegister;
+        VirtualRegister dreg = NoRegister;
+    };
+
+    // Linear scan allocation over the live interval of every virtual register, from the instruction defining it to the
+    // one last using it. Generated code runs straight through a function for now, so the intervals are exact. Values
+    // only go to memory if more of them are alive at once than there are registers. The value that is needed again
+    // the latest is the one spilled, it then lives in a slot of a spill area the function reserves on entry and every
+    // instruction using it reloads it into a scratch register.
+    class RegisterAllocator
+    {
+    public:
+        static constexpr usize RegisterCount = 16; // R0 to R15.
+
+        // Set aside as soon as anything has to be spilled.
+        static constexpr rlang::alvm::RegType SpillBase          = rlang::alvm::RegType::R13;
+        static constexpr rlang::alvm::RegType SourceScratch      = rlang::alvm::RegType::R14;
+        static constexpr rlang::alvm::RegType DestinationScratch = rlang::alvm::RegType::R15;
+
+    private:
+        static constexpr u8 Spilled = std::numeric_limits<u8>::max();
+
+        struct Interval
+        {
+            VirtualRegister reg{};
+            u32             start = std::numeric_limits<u32>::max();
+            u32             end{};
+        };
+
+    private:
+        std::vector<Interval> m_Intervals{};
+        std::vector<u8>       m_Assigned{}; // The real register of each virtual one, or Spilled.
+        std::vector<u32>      m_Ends{};     // Where the interval of each virtual register ends.
+        std::vector<u32>      m_Slots{};    // The spill slot of each spilled virtual register.
+        u32                   m_SlotCount{};
+        usize                 m_SpillCount{};
+
+    public:
+        // Rewrites the code of a function starting at first to use real registers. Its operands come in the order of
+        // its instructions and name virtual registers below virtual_count.
+        void Allocate(rlang::alvm::InstructionList& code, const std::span<const VirtualOperands> operands,
+                      const usize first, const usize virtual_count);
+
+        // How many virtual registers had to live in memory, over every function so far.
+        inline usize GetSpillCount() const noexcept { return m_SpillCount; }
+
+    private:
+        void ComputeIntervals(const std::span<const VirtualOperands> operands, const usize virtual_count);
+        bool Scan(const usize register_count);
+        void Assign(rlang::alvm::InstructionList& code, const std::span<const VirtualOperands> operands,
+                    const usize first) const;
+        void AssignWithSpills(rlang::alvm::InstructionList& code, const std::span<const VirtualOperands> operands,
+                              const usize first) const;
+    };
+} // namespace cmm::cmc::codegen
+
+#endif // CMC_COMPILER_REGISTER_ALLOCATOR_H
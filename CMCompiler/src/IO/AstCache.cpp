@@ -0,0 +1,470 @@
+#include "AstCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <type_traits>
+
+#include <fmt/core.h>
+
+namespace cmm::cmc {
+    using namespace ast;
+
+    namespace {
+        constexpr char Magic[8] = { 'C', 'M', 'C', 'A', 'C', 'H', 'E', '\0' };
+
+        // Followed by the arrays it counts, each starting at a multiple of eight bytes in the order listed here.
+        struct Header
+        {
+            char magic[8]{};
+            u32  format_version{};
+            u32  reserved{};
+            char compiler_version[32]{};
+            u32  statement_size{};   // The records are stored as they are in memory, a build that lays them out
+            u32  type_record_size{}; // differently can't read them.
+            u64  source_hash{};
+            u64  source_size{};     // The source itself, a snapshot is only used for the very same bytes.
+            u64  string_count{};    // The length of every interned string, then all of their characters.
+            u64  string_bytes{};    //
+            u64  type_count{};      // A TypeRecord for every interned type, then all of their fields and names.
+            u64  field_count{};     //
+            u64  type_name_bytes{}; //
+            u64  token_count{};     // The token stream's types, offsets, lengths and values.
+            u64  statement_count{}; // The tree's statements, children, token references, globals and constants.
+            u64  child_count{};     //
+            u64  token_ref_count{}; //
+            u64  global_count{};    //
+            u64  constant_count{};  //
+        };
+
+        struct TypeRecord
+        {
+            u64             length{};
+            u32             name_length{};
+            u32             first_field{};
+            u32             field_count{};
+            TypeId          element{};
+            FundamentalType ftype{};
+            i8              size{};
+            u8              padding[6]{};
+        };
+
+        static_assert(std::is_trivially_copyable_v<Statement>, "Statements are written out as they are in memory.");
+
+        // FNV-1a a word at a time with a shift to mix the high bits back in, a source is hashed on every run. It only
+        // names the snapshot, two sources that hash the same are told apart by the copy of the source in it.
+        u64 HashSource(const std::string_view source) noexcept
+        {
+            u64   hash = 0xcbf29ce484222325ull ^ source.size();
+            usize i    = 0;
+            for (; i + 8 <= source.size(); i += 8)
+            {
+                u64 word{};
+                std::memcpy(&word, source.data() + i, 8);
+                hash = (hash ^ word) * 0x100000001b3ull;
+                hash ^= hash >> 29;
+            }
+            for (; i < source.size(); ++i)
+                hash = (hash ^ (u8)source[i]) * 0x100000001b3ull;
+            return hash ^ (hash >> 32);
+        }
+
+        class SnapshotWriter
+        {
+        private:
+            std::ofstream& m_Out;
+            usize          m_Written{};
+
+        public:
+            explicit SnapshotWriter(std::ofstream& out) noexcept : m_Out(out) {}
+
+        public:
+            template <typename T>
+            void Write(const std::span<const T> items)
+            {
+                // Every array starts eight byte aligned, where one is follows from the header alone.
+                constexpr char zeros[8]{};
+                if (m_Written % 8 != 0)
+                {
+                    const usize padding = 8 - m_Written % 8;
+                    m_Out.write(zeros, (std::streamsize)padding);
+                    m_Written += padding;
+                }
+                m_Out.write((const char*)items.data(), (std::streamsize)items.size_bytes());
+                m_Written += items.size_bytes();
+            }
+        };
+
+        // Reads the arrays of a snapshot straight into the memory they end up in, nothing of the file is kept around.
+        class SnapshotReader
+        {
+        private:
+            std::ifstream& m_In;
+            usize          m_Size{};
+            usize          m_Position{};
+
+        public:
+            SnapshotReader(std::ifstream& in, const usize size) noexcept : m_In(in), m_Size(size) {}
+
+        public:
+            // Fills items with the next ones. False if the snapshot is cut short.
+            template <typename T>
+            bool Read(const std::span<T> items)
+            {
+                const usize start = (m_Position + 7) / 8 * 8;
+                if (start > m_Size || items.size() > (m_Size - start) / sizeof(T))
+                    return false;
+                m_In.ignore((std::streamsize)(start - m_Position));
+                m_In.read((char*)items.data(), (std::streamsize)items.size_bytes());
+                m_Position = start + items.size_bytes();
+                return m_In.good();
+            }
+
+            // Whether the next bytes are exactly these, compared a chunk at a time.
+            bool Matches(const std::string_view bytes)
+            {
+                const usize start = (m_Position + 7) / 8 * 8;
+                if (start > m_Size || bytes.size() > m_Size - start)
+                    return false;
+                m_In.ignore((std::streamsize)(start - m_Position));
+                m_Position = start + bytes.size();
+
+                char chunk[1 << 16];
+                for (usize offset = 0; offset < bytes.size(); offset += sizeof(chunk))
+                {
+                    const usize length = std::min(sizeof(chunk), bytes.size() - offset);
+                    if (!m_In.read(chunk, (std::streamsize)length) ||
+                        std::memcmp(chunk, bytes.data() + offset, length) != 0)
+                        return false;
+                }
+                return m_In.good();
+            }
+
+            // Nothing gets allocated for a count the rest of the file can't hold.
+            template <typename T>
+            bool Read(std::vector<T>& items, const u64 count)
+            {
+                const usize start = (m_Position + 7) / 8 * 8;
+                if (start > m_Size || count > (m_Size - start) / sizeof(T))
+                    return false;
+                items.resize(count);
+                return Read(std::span<T>{ items });
+            }
+        };
+
+        // The arrays of a snapshot, in the order they're stored in.
+        struct Sections
+        {
+            std::vector<u32>        string_lengths{};
+            std::vector<char>       string_bytes{};
+            std::vector<TypeRecord> type_records{};
+            std::vector<TypeId>     type_fields{};
+            std::vector<char>       type_names{};
+            std::vector<TokenType>  token_types{};
+            std::vector<u32>        token_offsets{};
+            std::vector<u32>        token_lengths{};
+            std::vector<i64>        token_values{};
+            std::vector<Statement>  statements{};
+            std::vector<NodeId>     children{};
+            std::vector<u32>        token_refs{};
+            std::vector<NodeId>     globals{};
+            std::vector<i64>        constants{};
+        };
+
+        std::optional<Sections> ReadSections(SnapshotReader& reader, const Header& header)
+        {
+            Sections   sections{};
+            const auto read = [&](auto& section, const u64 count) { return reader.Read(section, count); };
+            if (read(sections.string_lengths, header.string_count) && read(sections.string_bytes, header.string_bytes) &&
+                read(sections.type_records, header.type_count) && read(sections.type_fields, header.field_count) &&
+                read(sections.type_names, header.type_name_bytes) && read(sections.token_types, header.token_count) &&
+                read(sections.token_offsets, header.token_count) && read(sections.token_lengths, header.token_count) &&
+                read(sections.token_values, header.token_count) && read(sections.statements, header.statement_count) &&
+                read(sections.children, header.child_count) && read(sections.token_refs, header.token_ref_count) &&
+                read(sections.globals, header.global_count) && read(sections.constants, header.constant_count))
+                return sections;
+            return std::nullopt;
+        }
+
+        // Whether every id and range in the snapshot points inside of it, so nothing reading the tree later on can
+        // run off the end of an array. A snapshot that's been damaged without changing its length is caught here.
+        bool IsWellFormed(const Sections& sections, const std::string_view source) noexcept
+        {
+            const usize string_count    = sections.string_lengths.size();
+            const usize type_count      = sections.type_records.size();
+            const usize token_count     = sections.token_types.size();
+            const usize statement_count = sections.statements.size();
+
+            for (const auto& record : sections.type_records)
+            {
+                if (record.ftype > FundamentalType::UserDefined || record.element >= type_count)
+                    return false;
+            }
+            for (const auto field : sections.type_fields)
+            {
+                if (field >= type_count)
+                    return false;
+            }
+
+            // The stream always ends in an Eof token, which is what reads past its end get.
+            if (token_count == 0 || sections.token_types.back() != TokenType::Eof)
+                return false;
+            for (usize i = 0; i < token_count; ++i)
+            {
+                const auto type = sections.token_types[i];
+                if (type > TokenType::Eof || sections.token_offsets[i] > source.size() ||
+                    sections.token_lengths[i] > source.size() - sections.token_offsets[i] ||
+                    (type == TokenType::Identifier && (u64)sections.token_values[i] >= string_count))
+                    return false;
+            }
+
+            // Children come before their parents, which also rules out cycles.
+            for (NodeId id = 0; id < statement_count; ++id)
+            {
+                const auto& stmt = sections.statements[id];
+                if (stmt.kind > StatementKind::LiteralExpression || stmt.name >= string_count ||
+                    stmt.type >= type_count || (u64)stmt.first_child + stmt.child_count > sections.children.size())
+                    return false;
+                for (u32 i = 0; i < stmt.child_count; ++i)
+                {
+                    if (sections.children[stmt.first_child + i] >= id)
+                        return false;
+                }
+
+                const bool folded = stmt.kind == StatementKind::LiteralExpression && stmt.token_count == 0;
+                if (folded ? stmt.first_token >= sections.constants.size()
+                           : (u64)stmt.first_token + stmt.token_count > sections.token_refs.size())
+                    return false;
+            }
+            for (const auto ref : sections.token_refs)
+            {
+                if (ref >= token_count)
+                    return false;
+            }
+            for (const auto global : sections.globals)
+            {
+                if (global >= statement_count)
+                    return false;
+            }
+            return true;
+        }
+
+        // The strings and types of a snapshot, one by one. Each returns whether all of them are well formed.
+        template <typename F>
+        bool ForEachString(const Sections& sections, F&& f)
+        {
+            usize offset = 0;
+            for (usize i = 0; i < sections.string_lengths.size(); ++i)
+            {
+                const auto length = sections.string_lengths[i];
+                if (length > sections.string_bytes.size() - offset)
+                    return false;
+                if (!f(i, std::string_view{ sections.string_bytes.data() + offset, length }))
+                    return false;
+                offset += length;
+            }
+            return true;
+        }
+
+        template <typename F>
+        bool ForEachType(const Sections& sections, F&& f)
+        {
+            usize offset = 0;
+            for (usize i = 0; i < sections.type_records.size(); ++i)
+            {
+                const auto& record = sections.type_records[i];
+                if (record.name_length > sections.type_names.size() - offset ||
+                    record.first_field > sections.type_fields.size() ||
+                    record.field_count > sections.type_fields.size() - record.first_field)
+                    return false;
+
+                const auto fields =
+                    std::span<const TypeId>{ sections.type_fields }.subspan(record.first_field, record.field_count);
+                Type       type{ .name    = std::string{ sections.type_names.data() + offset, record.name_length },
+                                 .ftype   = record.ftype,
+                                 .fields  = { fields.begin(), fields.end() },
+                                 .element = record.element,
+                                 .length  = record.length,
+                                 .size    = record.size };
+                if (!f(i, std::move(type)))
+                    return false;
+                offset += record.name_length;
+            }
+            return true;
+        }
+
+        // The ids in a snapshot are only valid if interning its strings and types in order hands out the very same
+        // ones. That's the case if they're all distinct, which interning them into tables of our own tells, and if
+        // the global tables hold nothing but the same ones at the start, as in a fresh process. Nothing is interned
+        // into the global tables before this holds so a snapshot that doesn't fit leaves them as they were.
+        bool FitsGlobalTables(const Sections& sections)
+        {
+            const auto& global_strings = StringTable::Global();
+            StringTable strings{};
+            const bool  strings_fit = ForEachString(sections, [&](const usize i, const std::string_view str) {
+                return strings.Intern(str) == i && (i >= global_strings.Size() || global_strings.Get((SymbolId)i) == str);
+            });
+            if (!strings_fit)
+                return false;
+
+            const auto& global_types = TypeTable::Global();
+            const usize global_count = global_types.Size();
+            TypeTable   types{};
+            return ForEachType(sections, [&](const usize i, Type type) {
+                if (i < global_count && !(global_types.Get((TypeId)i) == type))
+                    return false;
+                return types.Intern(std::move(type)) == i;
+            });
+        }
+    } // namespace
+
+    AstCache::AstCache(std::string directory) noexcept : m_Directory(std::move(directory))
+    {
+    }
+
+    std::optional<SyntaxTree> AstCache::Load(const std::string_view source) const
+    {
+        const u64     source_hash = HashSource(source);
+        std::ifstream in(GetPath(source_hash), std::ios::binary | std::ios::ate);
+        if (!in.is_open())
+            return std::nullopt;
+        const auto size = in.tellg();
+        in.seekg(0);
+        if (size < 0)
+            return std::nullopt;
+
+        SnapshotReader reader{ in, (usize)size };
+        Header         header{};
+        if (!reader.Read(std::span<Header>{ &header, 1 }))
+            return std::nullopt;
+
+        if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.format_version != FormatVersion ||
+            std::strncmp(header.compiler_version, CMC_VERSION, sizeof(header.compiler_version)) != 0 ||
+            header.statement_size != sizeof(Statement) || header.type_record_size != sizeof(TypeRecord) ||
+            header.source_hash != source_hash || header.source_size != source.size() || !reader.Matches(source))
+            return std::nullopt;
+
+        auto sections = ReadSections(reader, header);
+        if (!sections || !IsWellFormed(*sections, source) || !FitsGlobalTables(*sections))
+            return std::nullopt;
+
+        ForEachString(*sections, [](usize, const std::string_view str) {
+            StringTable::Global().Intern(str);
+            return true;
+        });
+        ForEachType(*sections, [](usize, Type type) {
+            TypeTable::Global().Intern(std::move(type));
+            return true;
+        });
+
+        TokenStream tokens{ source };
+        tokens.m_Types   = std::move(sections->token_types);
+        tokens.m_Offsets = std::move(sections->token_offsets);
+        tokens.m_Lengths = std::move(sections->token_lengths);
+        tokens.m_Values  = std::move(sections->token_values);
+
+        SyntaxTree tree{};
+        tree.SetTokenStream(std::move(tokens));
+        tree.m_Statements = std::move(sections->statements);
+        tree.m_Children   = std::move(sections->children);
+        tree.m_TokenRefs  = std::move(sections->token_refs);
+        tree.m_Globals    = std::move(sections->globals);
+        tree.m_Constants  = std::move(sections->constants);
+        return tree;
+    }
+
+    void AstCache::Store(const std::string_view source, const SyntaxTree& tree) const
+    {
+        const auto& strings = StringTable::Global();
+        const auto& types   = TypeTable::Global();
+        const auto& tokens  = tree.GetTokenStream();
+
+        std::vector<u32> string_lengths{};
+        std::string      string_bytes{};
+        string_lengths.reserve(strings.Size());
+        for (SymbolId i = 0; i < strings.Size(); ++i)
+        {
+            string_lengths.push_back((u32)strings.Get(i).size());
+            string_bytes += strings.Get(i);
+        }
+
+        std::vector<TypeRecord> type_records{};
+        std::vector<TypeId>     type_fields{};
+        std::string             type_names{};
+        for (TypeId i = 0; i < types.Size(); ++i)
+        {
+            const auto& type = types.Get(i);
+            type_records.push_back(TypeRecord{ .length      = type.length,
+                                               .name_length = (u32)type.name.size(),
+                                               .first_field = (u32)type_fields.size(),
+                                               .field_count = (u32)type.fields.size(),
+                                               .element     = type.element,
+                                               .ftype       = type.ftype,
+                                               .size        = type.size });
+            type_fields.insert(type_fields.end(), type.fields.begin(), type.fields.end());
+            type_names += type.name;
+        }
+
+        Header header{ .format_version   = FormatVersion,
+                       .statement_size   = sizeof(Statement),
+                       .type_record_size = sizeof(TypeRecord),
+                       .source_hash      = HashSource(source),
+                       .source_size      = source.size(),
+                       .string_count     = string_lengths.size(),
+                       .string_bytes     = string_bytes.size(),
+                       .type_count       = type_records.size(),
+                       .field_count      = type_fields.size(),
+                       .type_name_bytes  = type_names.size(),
+                       .token_count      = tokens.Size(),
+                       .statement_count  = tree.m_Statements.size(),
+                       .child_count      = tree.m_Children.size(),
+                       .token_ref_count  = tree.m_TokenRefs.size(),
+                       .global_count     = tree.m_Globals.size(),
+                       .constant_count   = tree.m_Constants.size() };
+        std::memcpy(header.magic, Magic, sizeof(Magic));
+        std::strncpy(header.compiler_version, CMC_VERSION, sizeof(header.compiler_version) - 1);
+
+        // Written next to its final name and renamed into place, so a reader never sees half of a snapshot.
+        std::error_code ec{};
+        std::filesystem::create_directories(m_Directory, ec);
+        const auto path      = GetPath(header.source_hash);
+        const auto temp_path = path + ".tmp";
+        {
+            std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+            if (!out.is_open())
+                return;
+
+            SnapshotWriter writer{ out };
+            writer.Write(std::span<const Header>{ &header, 1 });
+            writer.Write(std::span<const char>{ source });
+            writer.Write(std::span<const u32>{ string_lengths });
+            writer.Write(std::span<const char>{ string_bytes });
+            writer.Write(std::span<const TypeRecord>{ type_records });
+            writer.Write(std::span<const TypeId>{ type_fields });
+            writer.Write(std::span<const char>{ type_names });
+            writer.Write(std::span<const TokenType>{ tokens.m_Types });
+            writer.Write(std::span<const u32>{ tokens.m_Offsets });
+            writer.Write(std::span<const u32>{ tokens.m_Lengths });
+            writer.Write(std::span<const i64>{ tokens.m_Values });
+            writer.Write(std::span<const Statement>{ tree.m_Statements });
+            writer.Write(std::span<const NodeId>{ tree.m_Children });
+            writer.Write(std::span<const u32>{ tree.m_TokenRefs });
+            writer.Write(std::span<const NodeId>{ tree.m_Globals });
+            writer.Write(std::span<const i64>{ tree.m_Constants });
+            if (!out.good())
+            {
+                out.close();
+                std::filesystem::remove(temp_path, ec);
+                return;
+            }
+        }
+        std::filesystem::rename(temp_path, path, ec);
+    }
+
+    std::string AstCache::GetPath(const u64 source_hash) const
+    {
+        return (std::filesystem::path{ m_Directory } / fmt::format("{:016x}.cmcast", source_hash)).string();
+    }
+} // namespace cmm::cmc
@@ -0,0 +1,48 @@
+#ifndef CMC_IO_AST_CACHE_H
+#define CMC_IO_AST_CACHE_H
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <CommonDef.h>
+
+#include "../Analyzer/Parser.h"
+
+#ifndef CMC_VERSION
+#define CMC_VERSION "dev"
+#endif
+
+namespace cmm::cmc {
+    // Snapshots of what the front end made of a source, one file per source in a cache directory. A snapshot is named
+    // after a hash of the source's contents and holds the source itself, which is compared with the one being loaded,
+    // the token stream, the tree and the strings and types their ids refer to as the raw arrays they are in memory.
+    // Loading one reads every array straight into the vector it ends up in, nothing gets lexed, parsed or decoded
+    // element by element and the file isn't kept in memory next to them.
+    class AstCache
+    {
+    public:
+        // Bumped whenever the layout of a snapshot changes. The compiler version and the sizes of the records stored
+        // as they are in memory have to match too for an existing snapshot to be used.
+        static constexpr u32 FormatVersion = 4;
+
+    private:
+        std::string m_Directory{};
+
+    public:
+        explicit AstCache(std::string directory) noexcept;
+
+    public:
+        // The tree of a source seen before. Nothing if there's no usable snapshot of it or if the global string and
+        // type tables already hold anything the snapshot's ids would clash with.
+        std::optional<ast::SyntaxTree> Load(const std::string_view source) const;
+
+        // Best effort, a snapshot that can't be written is simply not there next time.
+        void Store(const std::string_view source, const ast::SyntaxTree& tree) const;
+
+    private:
+        std::string GetPath(const u64 source_hash) const;
+    };
+} // namespace cmm::cmc
+
+#endif // CMC_IO_AST_CACHE_H
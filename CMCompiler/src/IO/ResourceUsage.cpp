@@ -0,0 +1,23 @@
+#include "ResourceUsage.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace cmm::cmc {
+    usize GetPeakResidentSize() noexcept
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        rusage usage{};
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+            return 0;
+#if defined(__APPLE__)
+        return (usize)usage.ru_maxrss / 1024;
+#else
+        return (usize)usage.ru_maxrss;
+#endif
+#else
+        return 0;
+#endif
+    }
+} // namespace cmm::cmc
@@ -0,0 +1,11 @@
+#ifndef CMC_IO_RESOURCE_USAGE_H
+#define CMC_IO_RESOURCE_USAGE_H
+
+#include <CommonDef.h>
+
+namespace cmm::cmc {
+    // The most memory the process had resident at any point, in kibibytes, or 0 if the platform can't tell.
+    usize GetPeakResidentSize() noexcept;
+} // namespace cmm::cmc
+
+#endif // CMC_IO_RESOURCE_USAGE_H
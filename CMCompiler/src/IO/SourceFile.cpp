@@ -0,0 +1,143 @@
+#include "SourceFile.h"
+
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CMC_SOURCE_FILE_POSIX
+#else
+#include <cstdio>
+#include <fstream>
+#endif
+
+namespace cmm::cmc {
+    SourceFile::SourceFile(SourceFile&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    SourceFile::~SourceFile()
+    {
+        Release();
+    }
+
+    SourceFile& SourceFile::operator=(SourceFile&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Release();
+            m_Mapping     = std::exchange(other.m_Mapping, nullptr);
+            m_MappingSize = std::exchange(other.m_MappingSize, 0);
+            m_Buffer      = std::move(other.m_Buffer);
+
+            // A view into a (possibly small string optimized) buffer must be pointed at our own copy.
+            m_View       = (m_Mapping != nullptr) ? other.m_View : std::string_view{ m_Buffer };
+            other.m_View = {};
+        }
+        return *this;
+    }
+
+    void SourceFile::Release() noexcept
+    {
+#ifdef CMC_SOURCE_FILE_POSIX
+        if (m_Mapping != nullptr)
+            munmap(m_Mapping, m_MappingSize);
+#endif
+        m_Mapping     = nullptr;
+        m_MappingSize = 0;
+        m_View        = {};
+        m_Buffer.clear();
+    }
+
+#ifdef CMC_SOURCE_FILE_POSIX
+    std::optional<SourceFile> SourceFile::Open(const std::string_view path)
+    {
+        const bool from_stdin = (path == "-");
+        const int  fd         = from_stdin ? STDIN_FILENO : open(std::string{ path }.c_str(), O_RDONLY);
+        if (fd < 0)
+            return std::nullopt;
+
+        SourceFile file{};
+        struct stat st{};
+        const bool is_regular = (fstat(fd, &st) == 0 && S_ISREG(st.st_mode));
+
+        // Map regular files straight into memory. Empty files cannot be mapped and files in pseudo filesystems report
+        // a size of zero so those go through read() like pipes do.
+        if (is_regular && st.st_size > 0)
+        {
+            void* mapping = mmap(nullptr, (usize)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED)
+            {
+                // We only ever walk the source front to back.
+                madvise(mapping, (usize)st.st_size, MADV_SEQUENTIAL);
+
+                file.m_Mapping     = mapping;
+                file.m_MappingSize = (usize)st.st_size;
+                file.m_View        = std::string_view{ (const char*)mapping, (usize)st.st_size };
+                if (!from_stdin)
+                    close(fd);
+                return file;
+            }
+        }
+
+        // Fall back to reading. If we know the size up front this is a single read(), otherwise keep doubling the
+        // buffer until we hit the end.
+        usize size = 0;
+        file.m_Buffer.resize((is_regular && st.st_size > 0) ? (usize)st.st_size : 64 * 1024);
+        while (true)
+        {
+            if (size == file.m_Buffer.size())
+                file.m_Buffer.resize(file.m_Buffer.size() * 2);
+
+            const auto count = read(fd, file.m_Buffer.data() + size, file.m_Buffer.size() - size);
+            if (count < 0 && errno == EINTR)
+                continue;
+            else if (count < 0)
+            {
+                if (!from_stdin)
+                    close(fd);
+                return std::nullopt;
+            }
+            else if (count == 0)
+                break;
+            size += (usize)count;
+        }
+        file.m_Buffer.resize(size);
+        file.m_View = file.m_Buffer;
+
+        if (!from_stdin)
+            close(fd);
+        return file;
+    }
+#else
+    std::optional<SourceFile> SourceFile::Open(const std::string_view path)
+    {
+        // No memory mapping here, just read the whole file in one go.
+        SourceFile file{};
+        if (path == "-")
+        {
+            char  chunk[64 * 1024];
+            usize count = 0;
+            while ((count = std::fread(chunk, 1, sizeof(chunk), stdin)) > 0)
+                file.m_Buffer.append(chunk, count);
+        }
+        else
+        {
+            std::ifstream fs(std::string{ path }, std::ios::binary | std::ios::ate);
+            if (!fs.is_open())
+                return std::nullopt;
+
+            file.m_Buffer.resize((usize)fs.tellg());
+            fs.seekg(0);
+            if (!fs.read(file.m_Buffer.data(), (std::streamsize)file.m_Buffer.size()))
+                return std::nullopt;
+        }
+        file.m_View = file.m_Buffer;
+        return file;
+    }
+#endif
+} // namespace cmm::cmc
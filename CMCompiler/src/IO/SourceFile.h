@@ -0,0 +1,45 @@
+#ifndef CMC_IO_SOURCE_FILE_H
+#define CMC_IO_SOURCE_FILE_H
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <CommonDef.h>
+
+namespace cmm::cmc {
+    // Read-only view of a whole input file. Regular files are memory mapped on POSIX systems so their bytes are never
+    // copied; pipes, stdin and everything else are read into memory with as few read() calls as possible. Tokens are
+    // views into the source so a SourceFile must outlive everything produced from it.
+    class SourceFile
+    {
+    private:
+        std::string_view m_View{};
+        void*            m_Mapping{};
+        usize            m_MappingSize{};
+        std::string      m_Buffer{};
+
+    public:
+        SourceFile() = default;
+        SourceFile(const SourceFile&) = delete;
+        SourceFile(SourceFile&& other) noexcept;
+        ~SourceFile();
+
+    public:
+        SourceFile& operator=(const SourceFile&) = delete;
+        SourceFile& operator=(SourceFile&& other) noexcept;
+
+    public:
+        // Opens path, or stdin if path is "-". Returns nothing if the file could not be opened or read.
+        static std::optional<SourceFile> Open(const std::string_view path);
+
+    public:
+        inline std::string_view GetView() const noexcept { return m_View; }
+        inline bool             IsMapped() const noexcept { return m_Mapping != nullptr; }
+
+    private:
+        void Release() noexcept;
+    };
+} // namespace cmm::cmc
+
+#endif // CMC_IO_SOURCE_FILE_H
@@ -1,11 +1,17 @@
-#include <fstream>
 #include <iostream>
+#include <optional>
+#include <string_view>
 #include <vector>
 
 #include <CommonDef.h>
 
+#include "Analyzer/AstWriter.h"
 #include "Analyzer/Parser.h"
 #include "Compiler/Compiler.h"
+#include "Compiler/PeepholeOptimizer.h"
+#include "IO/AstCache.h"
+#include "IO/ResourceUsage.h"
+#include "IO/SourceFile.h"
 
 using namespace cmm;
 using namespace cmm::cmc;
@@ -13,21 +19,96 @@ using namespace rlang::alvm;
 
 int main(int argc, const char* argv[])
 {
-    if (argc > 1)
+    const char*                          path        = nullptr;
+    bool                                 print_stats = false;
+    bool                                 pipelined   = false;
+    bool                                 optimize    = true;
+    std::optional<ast::AstWriter::Style> dump_style{};
+    std::optional<AstCache>              cache{};
+    for (int i = 1; i < argc; ++i)
     {
-        std::ifstream fs(argv[1]);
-        if (fs.is_open())
+        const std::string_view arg{ argv[i] };
+        if (arg == "--stats")
+            print_stats = true;
+        else if (arg == "--pipeline")
+            pipelined = true;
+        else if (arg == "-O0" || arg == "-O1")
+            optimize = arg == "-O1";
+        else if (arg == "--dump-ast" || arg == "--dump-ast=pretty")
+            dump_style = ast::AstWriter::Style::Pretty;
+        else if (arg == "--dump-ast=compact")
+            dump_style = ast::AstWriter::Style::Compact;
+        else if (arg.starts_with("--cache-dir="))
+            cache.emplace(std::string{ arg.substr(std::string_view{ "--cache-dir=" }.size()) });
+        else
+            path = argv[i];
+    }
+
+    if (pipelined && dump_style)
+    {
+        std::cerr << "cmc: --dump-ast can't be combined with --pipeline." << std::endl;
+        return -1;
+    }
+
+    if (pipelined && cache)
+    {
+        std::cerr << "cmc: --cache-dir can't be combined with --pipeline." << std::endl;
+        return -1;
+    }
+
+    if (path)
+    {
+        // The source file has to stay alive until we're done with the tokens since they are views into it.
+        auto source = SourceFile::Open(path);
+        if (source)
         {
-            auto src    = std::string((std::istreambuf_iterator<char>(fs)), (std::istreambuf_iterator<char>()));
-            auto parser = Parser(src);
-            auto tree   = parser.Parse();
-            nlohmann::ordered_json json = tree;
-            std::cout << std::setw(4) << json << std::endl;
-            auto compiler      = Compiler(tree);
-            auto compiled_code = compiler.Compile();
-            auto vm            = ALVM(std::vector<u8>{}, 255);
+            // Every phase takes the previous one's result over, so only the artifact in flight is ever alive. A
+            // pipelined compile never has the whole program's tree to dump.
+            auto                     src = source->GetView();
+            codegen::CompiledProgram program{};
+            try
+            {
+                if (pipelined)
+                    program = Compiler::CompilePipelined(Lexer(src).TokenizeParallel());
+                else
+                {
+                    // A snapshot has to be stored before the compiler interns anything of its own.
+                    auto cached = cache ? cache->Load(src) : std::nullopt;
+                    auto tree = cached ? std::move(*cached) : Parser(Lexer(src).TokenizeParallel()).ParseParallel();
+                    if (cache && !cached)
+                        cache->Store(src, tree);
+                    if (dump_style)
+                    {
+                        ast::AstWriter(std::cout, *dump_style).Write(tree);
+                        std::cout << std::endl;
+                    }
+                    program = Compiler(std::move(tree)).Compile();
+                }
+            }
+            catch (const CompileError& e)
+            {
+                std::cerr << e.what() << std::endl;
+                return -1;
+            }
+
+            codegen::PeepholeOptimizer optimizer{};
+            if (optimize)
+                optimizer.Optimize(program.code);
+
+            // String literals live in the data segment the VM's memory is initialized with.
+            auto vm = ALVM(std::move(program.data), 255);
             i64  result{};
-            vm.Run(compiled_code, result);
+            vm.Run(program.code, result);
+            if (print_stats)
+            {
+                for (usize i = 0; i < codegen::PeepholeOptimizer::PatternCount; ++i)
+                {
+                    const auto pattern = (codegen::PeepholePattern)i;
+                    std::cerr << "cmc: peephole " << codegen::GetPeepholePatternName(pattern) << ": "
+                              << optimizer.GetHits(pattern) << std::endl;
+                }
+                std::cerr << "cmc: peak RSS " << GetPeakResidentSize() << " KiB" << std::endl;
+            }
             return result;
         }
         else
@@ -37,6 +118,9 @@ int main(int argc, const char* argv[])
         }
     }
     else
-        std::cout << "Usage:\n\tcmc [file]" << std::endl;
+        std::cout << "Usage:\n\tcmc [--stats] [-O0|-O1] [--pipeline] [--cache-dir=<dir>] [--dump-ast[=pretty|compact]]"
+                     " [file]\n"
+                     "\tcmc - (read from stdin)"
+                  << std::endl;
     return 0;
 }
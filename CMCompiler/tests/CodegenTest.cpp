@@ -0,0 +1,303 @@
+#include <ALVM.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <CommonDef.h>
+
+#include "Analyzer/Parser.h"
+#include "Compiler/Compiler.h"
+#include "Compiler/PeepholeOptimizer.h"
+#include "IO/SourceFile.h"
+
+using namespace cmm;
+using namespace cmm::cmc;
+using namespace rlang::alvm;
+
+// What the compiler assumes about the ALVM instruction set. The ones the headers can tell are checked here, the others
+// are spelled out by the ReferenceVM below and checked against the ALVM itself by the alvm.* tests, which run the
+// same programs through cmc.
+static_assert((u8)RegType::R13 < (u8)RegType::SP && (u8)RegType::R14 < (u8)RegType::SP &&
+                  (u8)RegType::R15 < (u8)RegType::SP,
+              "The register allocator keeps R13 to R15 for spilled values, they have to be general registers.");
+static_assert(codegen::RegisterAllocator::RegisterCount == (usize)RegType::R15 + 1);
+static_assert(OpCode::Load != OpCode::Store, "Spilled values are reloaded with Load.");
+static_assert(codegen::StackGrowsUp, "The ALVM's stack grows upward, frames keep their locals above BP.");
+
+namespace {
+    // How many workers ParseParallel() may split a test program up between, at most one per function.
+    constexpr usize ParallelWorkerCount = 8;
+
+    // Runs straight-line code the way the compiler expects the ALVM to:
+    //  - Load reads a register from [sreg + disp], the way Store writes one to [dreg + disp].
+    //  - R0 to R15 are all the program's, nothing else ever writes to them, R13 to R15 included.
+    //  - Store and Push take imm64 when sreg is Nul.
+    //  - The stack grows the way codegen::StackGrowsUp says. Growing upward Push writes at SP and then adds 8 to it,
+    //    growing downward it takes 8 off first. Stack memory on the side of SP it grows towards is free and a push may
+    //    write there any moment, so reading or writing it fails the run.
+    //  - The first argument the ALVM is constructed with is the data segment its memory starts out as, a string
+    //    literal is printed from its address in it.
+    // Only the 64-bit forms of the instructions are modelled, anything else fails the run.
+    class ReferenceVM
+    {
+    private:
+        // Where the stack lives, it starts at one of the two ends. Loads and stores only ever go to the stack.
+        static constexpr i64 StackLow  = 1ll << 20;
+        static constexpr i64 StackHigh = 1ll << 40;
+
+        std::vector<u8>              m_Data{};
+        std::unordered_map<i64, i64> m_Memory{};
+        std::array<i64, 0x80>        m_Registers{}; // By number, Nul has a slot so a missing operand has one too.
+        std::string                  m_Error{};
+
+    public:
+        explicit ReferenceVM(std::vector<u8> data) noexcept : m_Data(std::move(data)) {}
+
+    public:
+        // Whether the program ran to its end, everything it printed goes to out.
+        bool Run(const InstructionList& code, std::ostream& out)
+        {
+            Reg(RegType::SP) = codegen::StackGrowsUp ? StackLow : StackHigh;
+            for (usize pc = 0; pc < code.size(); ++pc)
+            {
+                const auto& instruction = code[pc];
+                if (!Execute(instruction, out))
+                {
+                    if (m_Error.empty())
+                        return true;
+                    std::cerr << "reference vm: " << m_Error << " at instruction " << pc << "." << std::endl;
+                    return false;
+                }
+            }
+            std::cerr << "reference vm: The program doesn't end." << std::endl;
+            return false;
+        }
+
+    private:
+        i64& Reg(const RegType reg) noexcept { return m_Registers[(u8)reg & 0x7f]; }
+
+        // The value an instruction takes, an immediate in place of a source register.
+        i64 Source(const Instruction& instruction) noexcept
+        {
+            return instruction.sreg == RegType::Nul ? (i64)instruction.imm64 : Reg(instruction.sreg);
+        }
+
+        i64 Read(const i64 address) noexcept
+        {
+            const auto it = m_Memory.find(address);
+            return it != m_Memory.end() ? it->second : 0;
+        }
+
+        // Whether an address is in the part of the stack that's been pushed or reserved.
+        bool IsReserved(const i64 address) noexcept
+        {
+            const auto sp = Reg(RegType::SP);
+            if (codegen::StackGrowsUp)
+                return address >= StackLow && address + 8 <= sp;
+            return address >= sp && address + 8 <= StackHigh;
+        }
+
+        void Push(const i64 value) noexcept
+        {
+            auto& sp = Reg(RegType::SP);
+            if (!codegen::StackGrowsUp)
+                sp -= 8;
+            m_Memory[sp] = value;
+            if (codegen::StackGrowsUp)
+                sp += 8;
+        }
+
+        i64 Pop() noexcept
+        {
+            auto& sp = Reg(RegType::SP);
+            if (codegen::StackGrowsUp)
+                sp -= 8;
+            const auto value = Read(sp);
+            if (!codegen::StackGrowsUp)
+                sp += 8;
+            return value;
+        }
+
+        bool Fail(std::string error)
+        {
+            m_Error = std::move(error);
+            return false;
+        }
+
+        bool IsRegister(const RegType reg) const noexcept
+        {
+            return reg == RegType::Nul || ((u8)reg & 0x7f) <= (u8)RegType::PC;
+        }
+
+        // Whether to go on with the next instruction.
+        bool Execute(const Instruction& instruction, std::ostream& out)
+        {
+            if (instruction.size != Instruction{}.size)
+                return Fail("Only 64-bit operands are modelled");
+            if (!IsRegister(instruction.sreg) || !IsRegister(instruction.dreg) || !IsRegister(instruction.src_reg))
+                return Fail("Unknown register");
+
+            // Unsigned so an overflow wraps around instead of being undefined, the VM is two's complement.
+            const auto dst = (u64)Reg(instruction.dreg);
+            const auto src = (u64)Reg(instruction.sreg);
+            switch (instruction.opcode)
+            {
+                case OpCode::Add:
+                case OpCode::Sub:
+                case OpCode::Mul:
+                case OpCode::Div:
+                    if (instruction.sreg == RegType::Nul || instruction.dreg == RegType::Nul)
+                        return Fail("Arithmetic on an immediate");
+                    break;
+                default: break;
+            }
+
+            switch (instruction.opcode)
+            {
+                case OpCode::Nop: break;
+                case OpCode::End: return false;
+                case OpCode::Mov: Reg(instruction.dreg) = Source(instruction); break;
+                case OpCode::Lea: Reg(instruction.sreg) = Reg(instruction.src_reg) + instruction.disp; break;
+                case OpCode::Add: Reg(instruction.dreg) = (i64)(dst + src); break;
+                case OpCode::Sub: Reg(instruction.dreg) = (i64)(dst - src); break;
+                case OpCode::Mul: Reg(instruction.dreg) = (i64)(dst * src); break;
+                case OpCode::Div:
+                    if (src == 0)
+                        return Fail("Division by zero");
+                    Reg(instruction.dreg) /= (i64)src;
+                    break;
+                case OpCode::Store:
+                {
+                    const auto address = Reg(instruction.dreg) + instruction.disp;
+                    if (!IsReserved(address))
+                        return Fail("A store to free stack memory");
+                    m_Memory[address] = Source(instruction);
+                    break;
+                }
+                case OpCode::Load:
+                {
+                    const auto address = Reg(instruction.sreg) + instruction.disp;
+                    if (!IsReserved(address))
+                        return Fail("A load from free stack memory");
+                    Reg(instruction.dreg) = Read(address);
+                    break;
+                }
+                case OpCode::Push: Push(Source(instruction)); break;
+                case OpCode::Pop: Reg(instruction.sreg) = Pop(); break;
+                case OpCode::Leave:
+                    Reg(RegType::SP) = Reg(RegType::BP);
+                    Reg(RegType::BP) = Pop();
+                    break;
+                case OpCode::PInt: out << Reg(instruction.sreg) << '\n'; break;
+                case OpCode::PStr:
+                {
+                    const auto address = Reg(instruction.sreg);
+                    if (address < 0 || (usize)address >= m_Data.size())
+                        return Fail("A string outside of the data segment");
+                    const auto text = (const char*)m_Data.data() + address;
+                    out << std::string_view{ text, strnlen(text, m_Data.size() - (usize)address) } << '\n';
+                    break;
+                }
+                default: return Fail("Unsupported instruction");
+            }
+            return true;
+        }
+    };
+
+    // Whether two compiles of a program came out exactly the same, instruction for instruction.
+    bool IsSameProgram(const codegen::CompiledProgram& a, const codegen::CompiledProgram& b)
+    {
+        const auto same = [](const Instruction& x, const Instruction& y) {
+            return x.opcode == y.opcode && x.imm64 == y.imm64 && x.sreg == y.sreg && x.dreg == y.dreg &&
+                   x.src_reg == y.src_reg && x.disp == y.disp && x.size == y.size;
+        };
+        return a.data == b.data && std::equal(a.code.begin(), a.code.end(), b.code.begin(), b.code.end(), same);
+    }
+} // namespace
+
+// Compiles a program, runs it on the ReferenceVM and compares what it prints with the expected output. The program can
+// also be compiled a second way that has to give exactly the code the serial parse does:
+//  --parallel  parses it with ParseParallel(), split up between workers however small it is.
+//  --pipeline  compiles it with CompilePipelined(), the parser never more than one function ahead.
+int main(int argc, const char* argv[])
+{
+    const char*      path          = nullptr;
+    const char*      expected_path = nullptr;
+    bool             optimize      = true;
+    std::string_view alternative{};
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg{ argv[i] };
+        if (arg == "-O0" || arg == "-O1")
+            optimize = arg == "-O1";
+        else if (arg == "--parallel" || arg == "--pipeline")
+            alternative = arg;
+        else if (!path)
+            path = argv[i];
+        else
+            expected_path = argv[i];
+    }
+    if (!path || !expected_path)
+    {
+        std::cout << "Usage:\n\tcmc-codegen-test [-O0|-O1] [--parallel|--pipeline] [file] [expected output]"
+                  << std::endl;
+        return 1;
+    }
+
+    auto                source = SourceFile::Open(path);
+    const std::ifstream expected_file{ expected_path };
+    if (!source || !expected_file)
+    {
+        std::cerr << "cmc-codegen-test: input file non-existent." << std::endl;
+        return 1;
+    }
+
+    codegen::CompiledProgram program{};
+    codegen::CompiledProgram alternative_program{};
+    try
+    {
+        program = Compiler(Parser(Lexer(source->GetView()).TokenizeAll()).Parse()).Compile();
+        if (alternative == "--parallel")
+        {
+            Parser parser{ Lexer(source->GetView()).TokenizeAll() };
+            parser.SetMinParallelTokenCount(1);
+            alternative_program = Compiler(std::move(parser).ParseParallel(ParallelWorkerCount)).Compile();
+        }
+        else if (alternative == "--pipeline")
+            alternative_program = Compiler::CompilePipelined(Lexer(source->GetView()).TokenizeAll(), 1);
+    }
+    catch (const CompileError& e)
+    {
+        std::cerr << "cmc-codegen-test: " << e.what() << std::endl;
+        return 1;
+    }
+    if (!alternative.empty() && !IsSameProgram(program, alternative_program))
+    {
+        std::cerr << "cmc-codegen-test: " << path << " compiles differently with " << alternative << "." << std::endl;
+        return 1;
+    }
+    if (optimize)
+        codegen::PeepholeOptimizer().Optimize(program.code);
+
+    std::ostringstream output{};
+    if (!ReferenceVM(std::move(program.data)).Run(program.code, output))
+        return 1;
+
+    std::ostringstream expected{};
+    expected << expected_file.rdbuf();
+    if (output.str() != expected.str())
+    {
+        std::cerr << "cmc-codegen-test: " << path << " printed\n"
+                  << output.str() << "instead of\n"
+                  << expected.str() << std::flush;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include <ALVM.h>
+#include <array>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <string_view>
+
+#include <CommonDef.h>
+
+#include "Analyzer/ConstantFolder.h"
+#include "Analyzer/Lexer.h"
+#include "Analyzer/Parser.h"
+#include "Compiler/Compiler.h"
+
+using namespace cmm;
+using namespace cmm::cmc;
+using namespace cmm::cmc::ast;
+using namespace rlang::alvm;
+
+namespace {
+    constexpr i64 I64Min = std::numeric_limits<i64>::min();
+
+    // Every variable is initialized with one of the cases, the checks look the initializers up by name.
+    constexpr std::string_view Source = "fn f() -> i64 { return 1; }\n"
+                                        "fn g() -> bool { return true; }\n"
+                                        "fn main() -> i64 {\n"
+                                        "    let wrapped: i64 = 9223372036854775807 + 1;\n"
+                                        "    let quotient: i64 = -9223372036854775808 / -1;\n"
+                                        "    let by_zero: i64 = 1 / 0;\n"
+                                        "    let product: i64 = f() * 0;\n"
+                                        "    let product_left: i64 = 0 * f();\n"
+                                        "    let pure: i64 = wrapped * 0;\n"
+                                        "    let both: bool = g() && false;\n"
+                                        "    let either: bool = g() || true;\n"
+                                        "    let big: i64 = 2147483647;\n"
+                                        "    let one: i64 = 1;\n"
+                                        "    let half: i64 = 65536;\n"
+                                        "    return 0;\n"
+                                        "}\n";
+
+    constexpr std::string_view DaySource = "fn printi64(v: i64) -> i64 { return 0; }\n"
+                                           "fn main() -> i64 {\n"
+                                           "    let day: i64 = 60 * 60 * 24;\n"
+                                           "    printi64(day);\n"
+                                           "    return 0;\n"
+                                           "}\n";
+
+    // The expression a variable is initialized with.
+    NodeId FindInitializer(const SyntaxTree& tree, const std::string_view variable)
+    {
+        for (NodeId id = 0; id < tree.Size(); ++id)
+        {
+            if (tree[id].kind == StatementKind::VariableDeclaration &&
+                StringTable::Global().Get(tree[id].name) == variable)
+                return tree.GetChild(tree.GetChild(id, 0), 0);
+        }
+        std::cerr << "cmc-constant-folder-test: there's no variable " << variable << "." << std::endl;
+        std::exit(1);
+    }
+
+    bool IsLiteral(const SyntaxTree& tree, const NodeId id, const i64 value)
+    {
+        return tree[id].kind == StatementKind::LiteralExpression && tree.GetLiteralValue(id) == value;
+    }
+
+    bool Check(const bool condition, const std::string_view what)
+    {
+        if (!condition)
+            std::cerr << "cmc-constant-folder-test: " << what << std::endl;
+        return condition;
+    }
+
+    bool CheckFolding()
+    {
+        auto tree = Parser(Lexer(Source).TokenizeAll()).Parse();
+
+        // Integer literals are always i64, a tree with i32 operations on constants can only be made by hand.
+        const NodeId big      = FindInitializer(tree, "big");
+        const NodeId one      = FindInitializer(tree, "one");
+        const NodeId half     = FindInitializer(tree, "half");
+        const NodeId sum32    = tree.Add(Statement{ .kind = StatementKind::AdditionExpression,
+                                                    .type = TypeTable::Integer32 },
+                                         std::array{ big, one }, {});
+        const NodeId product32 = tree.Add(Statement{ .kind = StatementKind::MultiplicationExpression,
+                                                     .type = TypeTable::Integer32 },
+                                          std::array{ half, half }, {});
+
+        ConstantFolder(tree).Fold();
+
+        const auto has_call = [&](const NodeId id) {
+            for (const auto child : tree.GetChildren(id))
+            {
+                if (tree[child].kind == StatementKind::FunctionCallExpression)
+                    return true;
+            }
+            return false;
+        };
+        const auto wrapped      = FindInitializer(tree, "wrapped");
+        const auto quotient     = FindInitializer(tree, "quotient");
+        const auto product      = FindInitializer(tree, "product");
+        const auto product_left = FindInitializer(tree, "product_left");
+        const auto both         = FindInitializer(tree, "both");
+        const auto either       = FindInitializer(tree, "either");
+
+        bool ok = Check(IsLiteral(tree, wrapped, I64Min), "i64 addition doesn't wrap around.");
+        ok &= Check(IsLiteral(tree, sum32, std::numeric_limits<i32>::min()), "i32 addition doesn't wrap at 32 bits.");
+        ok &= Check(IsLiteral(tree, product32, 0), "i32 multiplication doesn't wrap at 32 bits.");
+
+        // What the VM does with these is up to the VM.
+        ok &= Check(tree[quotient].kind == StatementKind::DivisionExpression &&
+                        IsLiteral(tree, tree.GetChild(quotient, 0), I64Min) &&
+                        IsLiteral(tree, tree.GetChild(quotient, 1), -1),
+                    "i64 MIN / -1 wasn't left for run time.");
+        ok &= Check(tree[FindInitializer(tree, "by_zero")].kind == StatementKind::DivisionExpression,
+                    "A division by zero wasn't left for run time.");
+
+        // An operand that decides the result on its own only replaces the operation if the other one has no effects.
+        ok &= Check(tree[product].kind == StatementKind::MultiplicationExpression && has_call(product),
+                    "f() * 0 lost the call.");
+        ok &= Check(tree[product_left].kind == StatementKind::MultiplicationExpression && has_call(product_left),
+                    "0 * f() lost the call.");
+        ok &= Check(tree[both].kind == StatementKind::LogicalAndExpression && has_call(both),
+                    "g() && false lost the call.");
+        ok &= Check(tree[either].kind == StatementKind::LogicalOrExpression && has_call(either),
+                    "g() || true lost the call.");
+        ok &= Check(IsLiteral(tree, FindInitializer(tree, "pure"), 0), "wrapped * 0 wasn't folded.");
+        return ok;
+    }
+
+    // A constant expression costs a single Mov of its value, without the peephole optimizer having to help.
+    bool CheckCode()
+    {
+        const auto program = Compiler(Parser(Lexer(DaySource).TokenizeAll()).Parse()).Compile();
+
+        usize immediates{};
+        usize arithmetic{};
+        bool  day{};
+        for (const auto& instruction : program.code)
+        {
+            switch (instruction.opcode)
+            {
+                case OpCode::Mov:
+                    if (instruction.sreg == RegType::Nul)
+                    {
+                        ++immediates;
+                        day = day || instruction.imm64 == 60 * 60 * 24;
+                    }
+                    break;
+                case OpCode::Add:
+                case OpCode::Sub:
+                case OpCode::Mul:
+                case OpCode::Div: ++arithmetic; break;
+                default: break;
+            }
+        }
+        return Check(immediates == 1 && day && arithmetic == 0, "60 * 60 * 24 isn't a single Mov of 86400.");
+    }
+} // namespace
+
+// Checks what the ConstantFolder makes of the cases that are easy to get wrong, on the tree and on the code.
+int main()
+{
+    const bool folding = CheckFolding();
+    const bool code    = CheckCode();
+    return folding && code ? 0 : 1;
+}
@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include <CommonDef.h>
+
+#include "Analyzer/Document.h"
+#include "Analyzer/Lexer.h"
+
+using namespace cmm;
+using namespace cmm::cmc;
+
+namespace {
+    // Strings and character literals spanning lines, so there's plenty for an edit to open or close.
+    constexpr std::string_view InitialText = "fn printstr(s: string) -> i64 { return 0; }\n"
+                                             "fn main() -> i64 {\n"
+                                             "    let greeting: string = \"hello\n"
+                                             "world\";\n"
+                                             "    let c: char = 'q';\n"
+                                             "    let quote: char = '\"';\n"
+                                             "    let x: i64 = 60 * 60 * 24;\n"
+                                             "    if x == 86400 { printstr(greeting); }\n"
+                                             "    printstr(\"done\");\n"
+                                             "    return x / 2;\n"
+                                             "}\n";
+
+    // What random edits insert, from nothing over single characters that open or close a literal to whole lines.
+    constexpr std::array<std::string_view, 16> Snippets = {
+        "", "a", "\"", "'", "'x'", "\n", " ", "+", "=", "12", "\"str\nx\"", "fn", "}", "let x: i64 = 3;\n", "\"\"",
+        "'\"'",
+    };
+
+    class DocumentChecker
+    {
+    private:
+        Document    m_Document;
+        std::string m_Text{};
+        usize       m_Applied{};
+        usize       m_Rejected{};
+
+    public:
+        explicit DocumentChecker(const std::string_view text) : m_Document(std::string{ text }), m_Text(text) {}
+
+    public:
+        inline usize            GetApplied() const noexcept { return m_Applied; }
+        inline usize            GetRejected() const noexcept { return m_Rejected; }
+        inline usize            GetSize() const noexcept { return m_Text.size(); }
+        inline std::string_view GetText() const noexcept { return m_Text; }
+
+    public:
+        // Applies an edit to the document and to a plain copy of its text, then checks the document's tokens against
+        // lexing that copy from scratch. An edit the lexer rejects has to leave the document as it was.
+        bool Apply(const usize offset, const usize length, const std::string_view text)
+        {
+            try
+            {
+                m_Document.Edit(offset, length, text);
+            }
+            catch (const std::exception&)
+            {
+                ++m_Rejected;
+                if (m_Document.GetText() != m_Text)
+                    return Fail(offset, length, text, "a rejected edit changed the text");
+                return Matches(offset, length, text);
+            }
+
+            ++m_Applied;
+            m_Text.replace(offset, length, text);
+            if (m_Document.GetText() != m_Text)
+                return Fail(offset, length, text, "the text differs");
+            return Matches(offset, length, text);
+        }
+
+    private:
+        bool Matches(const usize offset, const usize length, const std::string_view text)
+        {
+            Lexer lexer{ m_Text };
+            lexer.SetStringTable(nullptr);
+
+            TokenStream expected{};
+            try
+            {
+                expected = lexer.TokenizeAll();
+            }
+            catch (const std::exception&)
+            {
+                return Fail(offset, length, text, "the document took a text the lexer rejects");
+            }
+
+            const auto& actual = m_Document.GetTokens();
+            if (actual.Size() != expected.Size())
+                return Fail(offset, length, text,
+                            "it has " + std::to_string(actual.Size()) + " tokens instead of " +
+                                std::to_string(expected.Size()));
+            for (usize i = 0; i < expected.Size(); ++i)
+            {
+                const auto a = actual.Get(i);
+                const auto e = expected.Get(i);
+                if (a.type != e.type || a.num != e.num || a.span.offset != e.span.offset || a.span.text != e.span.text)
+                    return Fail(offset, length, text, "token " + std::to_string(i) + " differs");
+            }
+            return true;
+        }
+
+        bool Fail(const usize offset, const usize length, const std::string_view text, const std::string& what)
+        {
+            std::cerr << "cmc-document-test: after replacing " << length << " bytes at " << offset << " with '" << text
+                      << "' " << what << ", the text is now\n"
+                      << m_Text << std::endl;
+            return false;
+        }
+    };
+
+    // Edits at the very start and end of a text that open and close strings, every one of which has to be accepted.
+    // A string that's still open at the end of the text runs up to it.
+    bool CheckEdgeCases()
+    {
+        DocumentChecker ends{ "let a: i64 = 1;\nlet b: i64 = 2;\n" };
+        const auto      end = [&] { return ends.GetSize(); };
+        const bool      ends_match =
+            // Opened at the start and closed at the end, then the one at the start removed so the one at the end
+            // opens a string instead, which is removed too.
+            ends.Apply(0, 0, "\"") && ends.Apply(end(), 0, "\"") && ends.Apply(0, 1, "") &&
+            ends.Apply(end() - 1, 1, "") &&
+            // Whole lines added at both ends and the last character removed.
+            ends.Apply(0, 0, "fn f() -> i64 { return 1; }\n") && ends.Apply(end(), 0, "fn g() -> i64 { }\n") &&
+            ends.Apply(end() - 1, 1, "");
+
+        DocumentChecker strings{ "let s: string = \"a\nb\";\nlet t: string = \"c\";\n" };
+        const auto      find = [&](const std::string_view what) { return strings.GetText().find(what); };
+        const bool      strings_match =
+            // Without the quote opening a multi-line string its contents become code and every quote after it flips,
+            // putting it back flips them again.
+            strings.Apply(find("\"a"), 1, "") && strings.Apply(find("a\n"), 0, "\"") &&
+            // A string closed early and opened again right after.
+            strings.Apply(find("\"c") + 1, 0, "\" + \"") && strings.Apply(find("\" + \""), 4, "");
+
+        if (ends_match && strings_match && ends.GetRejected() + strings.GetRejected() != 0)
+        {
+            std::cerr << "cmc-document-test: an edge case edit was rejected by the lexer." << std::endl;
+            return false;
+        }
+        return ends_match && strings_match;
+    }
+} // namespace
+
+// Applies edits to a Document and checks that its token stream is always the one lexing its whole text would give.
+// Some edits are picked by hand, the rest are random from a fixed seed and a good share of them land at the very
+// start or end of the text. The number of random edits can be given, it defaults to 20000.
+int main(int argc, const char* argv[])
+{
+    const usize edits = argc > 1 ? (usize)std::max(std::atoi(argv[1]), 0) : 20000;
+
+    if (!CheckEdgeCases())
+        return 1;
+
+    DocumentChecker checker{ InitialText };
+    std::mt19937 rng{ 7 };
+    for (usize i = 0; i < edits; ++i)
+    {
+        const auto size   = checker.GetSize();
+        const auto where  = rng() % 8;
+        const auto offset = where == 0 ? 0 : where == 1 ? size : rng() % (size + 1);
+
+        // Removing a little more than gets inserted on average keeps the text from growing without bound.
+        const auto length = std::min<usize>(rng() % 6, size - offset);
+        if (!checker.Apply(offset, length, Snippets[rng() % Snippets.size()]))
+            return 1;
+    }
+
+    std::cout << "cmc-document-test: " << checker.GetApplied() << " edits applied, " << checker.GetRejected()
+              << " rejected by the lexer." << std::endl;
+    return 0;
+}
@@ -0,0 +1,187 @@
+#include <ALVM.h>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <CommonDef.h>
+
+#include "Compiler/PeepholeOptimizer.h"
+
+using namespace cmm;
+using namespace cmm::cmc;
+using namespace cmm::cmc::codegen;
+using namespace rlang::alvm;
+
+namespace {
+    Instruction Op(const OpCode opcode) noexcept
+    {
+        return Instruction{ .opcode = opcode };
+    }
+
+    Instruction Mov(const RegType from, const RegType to) noexcept
+    {
+        return Instruction{ .opcode = OpCode::Mov, .sreg = from, .dreg = to };
+    }
+
+    Instruction MovImm(const u64 value, const RegType to) noexcept
+    {
+        return Instruction{ .opcode = OpCode::Mov, .imm64 = value, .dreg = to };
+    }
+
+    Instruction Push(const RegType from) noexcept
+    {
+        return Instruction{ .opcode = OpCode::Push, .sreg = from };
+    }
+
+    Instruction PushImm(const u64 value) noexcept
+    {
+        return Instruction{ .opcode = OpCode::Push, .imm64 = value };
+    }
+
+    Instruction Pop(const RegType to) noexcept
+    {
+        return Instruction{ .opcode = OpCode::Pop, .sreg = to };
+    }
+
+    // A store to a local, [BP + disp].
+    Instruction Store(const RegType from, const i32 disp) noexcept
+    {
+        return Instruction{ .opcode = OpCode::Store, .sreg = from, .dreg = MemReg(RegType::BP), .disp = disp };
+    }
+
+    Instruction StoreImm(const u64 value, const i32 disp) noexcept
+    {
+        return Instruction{ .opcode = OpCode::Store, .imm64 = value, .dreg = MemReg(RegType::BP), .disp = disp };
+    }
+
+    // A program before and after the optimizer with nothing but one pattern enabled, and how often it applies.
+    struct Case
+    {
+        std::string_view name{};
+        PeepholePattern  pattern{};
+        InstructionList  before{};
+        InstructionList  after{};
+        usize            hits{};
+    };
+
+    bool IsSameCode(const InstructionList& a, const InstructionList& b)
+    {
+        const auto same = [](const Instruction& x, const Instruction& y) {
+            return x.opcode == y.opcode && x.imm64 == y.imm64 && x.sreg == y.sreg && x.dreg == y.dreg &&
+                   x.src_reg == y.src_reg && x.disp == y.disp && x.size == y.size;
+        };
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(), same);
+    }
+
+    void Print(const InstructionList& code)
+    {
+        for (const auto& i : code)
+        {
+            std::cerr << "\topcode " << (u32)i.opcode << ", imm64 " << i.imm64 << ", sreg " << (u32)i.sreg << ", dreg "
+                      << (u32)i.dreg << ", disp " << i.disp << ", size " << (i32)i.size << '\n';
+        }
+    }
+
+    bool Fail(const Case& c, const std::string_view what, const InstructionList& code)
+    {
+        std::cerr << "cmc-peephole-test: " << c.name << ": " << what << ", the code is now\n";
+        Print(code);
+        std::cerr << std::flush;
+        return false;
+    }
+
+    PeepholeOptimizer MakeOptimizer(const bool enabled)
+    {
+        PeepholeOptimizer optimizer{};
+        for (usize i = 0; i < PeepholeOptimizer::PatternCount; ++i)
+            optimizer.SetEnabled((PeepholePattern)i, enabled);
+        return optimizer;
+    }
+
+    // The pattern on its own has to turn the program into what the case expects, and hits add up from program to
+    // program. The program stays exactly as it is with the pattern disabled, with nothing else enabled and with
+    // everything else enabled alike.
+    bool Check(const Case& c)
+    {
+        auto only = MakeOptimizer(false);
+        only.SetEnabled(c.pattern, true);
+        for (usize run = 1; run <= 2; ++run)
+        {
+            auto code = c.before;
+            only.Optimize(code);
+            if (!IsSameCode(code, c.after))
+                return Fail(c, "the pattern didn't give the expected code", code);
+            if (only.GetHits(c.pattern) != c.hits * run)
+                return Fail(c, "the pattern was applied " + std::to_string(only.GetHits(c.pattern)) + " times", code);
+        }
+
+        auto none = MakeOptimizer(false);
+        auto code = c.before;
+        none.Optimize(code);
+        if (!IsSameCode(code, c.before))
+            return Fail(c, "the code changed with every pattern disabled", code);
+
+        auto others = MakeOptimizer(true);
+        others.SetEnabled(c.pattern, false);
+        code = c.before;
+        others.Optimize(code);
+        if (others.GetHits(c.pattern) != 0)
+            return Fail(c, "the pattern was applied while disabled", code);
+        return true;
+    }
+} // namespace
+
+// Runs the peephole optimizer over small instruction lists, one pattern at a time. Some cases are ones a pattern has
+// to leave alone and the last ones jump or call somewhere, so removed instructions have to stay behind as Nops.
+int main()
+{
+    using enum RegType;
+    using enum PeepholePattern;
+
+    const std::vector<Case> cases = {
+        { "frame", RedundantFrame,
+          { Push(BP), Mov(SP, BP), MovImm(1, R0), Op(OpCode::Leave), Op(OpCode::End) },
+          { MovImm(1, R0), Op(OpCode::End) }, 1 },
+        { "frame around a push", RedundantFrame,
+          { Push(BP), Mov(SP, BP), Push(R0), Op(OpCode::Leave), Op(OpCode::End) },
+          { Push(BP), Mov(SP, BP), Push(R0), Op(OpCode::Leave), Op(OpCode::End) }, 0 },
+        { "push/pop", PushPop, { Push(R1), Pop(R2), Op(OpCode::End) }, { Mov(R1, R2), Op(OpCode::End) }, 1 },
+        { "push/pop of one register", PushPop, { Push(R1), Pop(R1), Op(OpCode::End) }, { Op(OpCode::End) }, 1 },
+        { "move to itself", RedundantMove, { Mov(R1, R1), Op(OpCode::End) }, { Op(OpCode::End) }, 1 },
+        { "repeated move", RedundantMove,
+          { Mov(R1, R2), MovImm(3, R3), Mov(R1, R2), Op(OpCode::End) },
+          { Mov(R1, R2), MovImm(3, R3), Op(OpCode::End) }, 1 },
+        { "move back", RedundantMove, { Mov(R1, R2), Mov(R2, R1), Op(OpCode::End) }, { Mov(R1, R2), Op(OpCode::End) },
+          1 },
+        { "move after a write", RedundantMove,
+          { Mov(R1, R2), MovImm(3, R1), Mov(R1, R2), Op(OpCode::End) },
+          { Mov(R1, R2), MovImm(3, R1), Mov(R1, R2), Op(OpCode::End) }, 0 },
+        { "move chain", MoveChain,
+          { MovImm(5, R1), Mov(R1, R2), MovImm(0, R1), Op(OpCode::End) },
+          { MovImm(5, R2), MovImm(0, R1), Op(OpCode::End) }, 1 },
+        { "move chain read later", MoveChain,
+          { MovImm(5, R1), Mov(R1, R2), Push(R1), Op(OpCode::End) },
+          { MovImm(5, R1), Mov(R1, R2), Push(R1), Op(OpCode::End) }, 0 },
+        { "dead move", DeadMove, { MovImm(1, R1), MovImm(2, R1), Op(OpCode::End) }, { MovImm(2, R1), Op(OpCode::End) },
+          1 },
+        { "store immediate", StoreImmediate,
+          { MovImm(7, R1), Store(R1, 8), MovImm(0, R1), Op(OpCode::End) },
+          { StoreImm(7, 8), MovImm(0, R1), Op(OpCode::End) }, 1 },
+        { "push immediate", StoreImmediate,
+          { MovImm(7, R1), Push(R1), MovImm(0, R1), Op(OpCode::End) },
+          { PushImm(7), MovImm(0, R1), Op(OpCode::End) }, 1 },
+        { "dead move before a jump", DeadMove,
+          { MovImm(1, R1), MovImm(2, R1), Op(OpCode::Jmp), Op(OpCode::End) },
+          { Op(OpCode::Nop), MovImm(2, R1), Op(OpCode::Jmp), Op(OpCode::End) }, 1 },
+        { "push/pop before a call", PushPop,
+          { Push(R1), Pop(R1), Op(OpCode::Call), Op(OpCode::End) },
+          { Op(OpCode::Nop), Op(OpCode::Nop), Op(OpCode::Call), Op(OpCode::End) }, 1 },
+    };
+
+    bool ok = true;
+    for (const auto& c : cases)
+        ok = Check(c) && ok;
+    return ok ? 0 : 1;
+}
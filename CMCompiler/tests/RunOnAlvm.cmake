@@ -0,0 +1,15 @@
+# Runs PROGRAM through cmc, which executes it on the ALVM, and compares what it printed with PROGRAM.expected. Only
+# the printed values are compared, not how the ALVM separates them.
+execute_process(
+  COMMAND "${CMC}" ${LEVEL} "${PROGRAM}"
+  OUTPUT_VARIABLE output
+  RESULT_VARIABLE result)
+file(READ "${PROGRAM}.expected" expected)
+
+string(STRIP "${output}" output)
+string(STRIP "${expected}" expected)
+string(REGEX REPLACE "[ \t\r\n]+" ";" output "${output}")
+string(REGEX REPLACE "[ \t\r\n]+" ";" expected "${expected}")
+if(NOT output STREQUAL expected)
+  message(FATAL_ERROR "${PROGRAM} printed\n${output}\ninstead of\n${expected}\n(cmc exited with ${result})")
+endif()
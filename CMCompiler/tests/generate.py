@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+# Writes a program of straight-line i64 arithmetic and the values it prints, for the codegen tests. Every value is
+# computed here the way the ALVM computes it, wrapping around at 64 bits and dividing towards zero. Sums of products
+# keep the precedence easy to follow, and enough variables stay alive at once for the register allocator to spill.
+#
+# CMakeLists.txt writes the random<seed>.cmm programs with it into the build tree, for every seed from 10 to 45:
+#   generate.py <seed> 3 <(seed % 4 + 1) * 20> random<seed>.cmm
+
+import random
+import sys
+
+if len(sys.argv) != 5:
+    print('Usage: generate.py <seed> <functions> <variables per function> <output>')
+    sys.exit(1)
+
+random.seed(int(sys.argv[1]))
+function_count = int(sys.argv[2])
+variable_count = int(sys.argv[3])
+output = sys.argv[4]
+
+def wrap(x):
+    x %= 1 << 64
+    return x - (1 << 64) if x >= 1 << 63 else x
+
+def divide(a, b):
+    q = abs(a) // abs(b)
+    return wrap(q if (a < 0) == (b < 0) else -q)
+
+lines = ['fn printi64(v: i64) -> i64 { return 0; }']
+expected = []
+for f in range(function_count):
+    env = {}
+
+    def atom():
+        if env and random.random() < 0.7:
+            n = random.choice(list(env))
+            return n, env[n]
+        if random.random() < 0.1 and env:
+            n = random.choice(list(env))
+            return '-' + n, wrap(-env[n])
+        v = random.randint(0, 100000)
+        return str(v), v
+
+    def sum_of_products(depth):
+        text, total = '', 0
+        for t in range(random.randint(1, depth + 1)):
+            ls, lv = atom()
+            if random.random() < 0.4:
+                rs, rv = atom()
+                term, value = f'{ls} * {rs}', wrap(lv * rv)
+            elif random.random() < 0.2:
+                k = random.randint(1, 9)
+                term, value = f'{ls} / {k}', divide(lv, k)
+            else:
+                term, value = ls, lv
+            if t == 0:
+                text, total = term, value
+            else:
+                op = random.choice('+-')
+                text += f' {op} {term}'
+                total = wrap(total + value if op == '+' else total - value)
+        return text, total
+
+    lines.append(f'fn f{f}() -> i64 {{')
+    for i in range(variable_count):
+        text, value = sum_of_products(4)
+        lines.append(f' let v{i}: i64 = {text};')
+        env[f'v{i}'] = value
+        if random.random() < 0.2:
+            n = random.choice(list(env))
+            lines.append(f' printi64({n});')
+            expected.append(env[n])
+    for n in random.sample(list(env), min(len(env), 30)):
+        lines.append(f' printi64({n});')
+        expected.append(env[n])
+    lines.append(' return 0; }')
+
+with open(output, 'w') as f:
+    f.write('\n'.join(lines) + '\n')
+with open(output + '.expected', 'w') as f:
+    f.write('\n'.join(map(str, expected)) + '\n')